@@ -0,0 +1 @@
+#include "../src/tappsettings.h"
@@ -0,0 +1 @@
+#include "../src/tmetrics.h"
@@ -0,0 +1 @@
+#include "../src/tsqlresultcache.h"
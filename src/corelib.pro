@@ -45,6 +45,7 @@ win32 {
   FRAMEWORK_TEST.path = Headers/TfTest
   QMAKE_BUNDLE_DATA += FRAMEWORK_HEADERS FRAMEWORK_TEST
 } else:unix {
+  LIBS += -lrt
   header.files = $$HEADER_FILES $$HEADER_CLASSES
   isEmpty(header.path) {
     header.path = /usr/include/treefrog
@@ -58,6 +59,10 @@ win32 {
   DEFINES += TF_NO_DEBUG
 }
 
+!isEmpty( use_trace ) {
+  DEFINES += TF_TRACE_FUNCTION
+}
+
 isEmpty( use_gui ) {
   QT    -= gui
 } else {
@@ -101,6 +106,8 @@ HEADERS += tsqlqueryormapperiterator.h
 SOURCES += tsqlqueryormapperiterator.cpp
 HEADERS += tsqltransaction.h
 SOURCES += tsqltransaction.cpp
+HEADERS += tsqlresultcache.h
+SOURCES += tsqlresultcache.cpp
 HEADERS += tcriteria.h
 SOURCES += tcriteria.cpp
 HEADERS += tcriteriaconverter.h
@@ -135,6 +142,10 @@ HEADERS += ttemporaryfile.h
 SOURCES += ttemporaryfile.cpp
 HEADERS += tcookiejar.h
 SOURCES += tcookiejar.cpp
+HEADERS += tappsettings.h
+SOURCES += tappsettings.cpp
+HEADERS += tmetrics.h
+SOURCES += tmetrics.cpp
 HEADERS += tsession.h
 SOURCES += tsession.cpp
 HEADERS += tsessionmanager.h
@@ -147,6 +158,8 @@ HEADERS += tsessioncookiestore.h
 SOURCES += tsessioncookiestore.cpp
 HEADERS += tsessionfilestore.h
 SOURCES += tsessionfilestore.cpp
+HEADERS += tsessionmemorystore.h
+SOURCES += tsessionmemorystore.cpp
 HEADERS += thtmlparser.h
 SOURCES += thtmlparser.cpp
 HEADERS += tabstractmodel.h
@@ -155,6 +168,7 @@ HEADERS += tmodelutil.h
 #SOURCES += tmodelutil.cpp
 HEADERS += tsystemglobal.h
 SOURCES += tsystemglobal.cpp
+SOURCES += ttracebuffer.cpp
 HEADERS += tglobal.h
 SOURCES += tglobal.cpp
 HEADERS += taccesslog.h
@@ -165,6 +179,8 @@ HEADERS += tlog.h
 SOURCES += tlog.cpp
 HEADERS += tlogger.h
 SOURCES += tlogger.cpp
+HEADERS += tlayoututil.h
+SOURCES += tlayoututil.cpp
 HEADERS += tloggerfactory.h
 SOURCES += tloggerfactory.cpp
 HEADERS += tloggerplugin.h
@@ -251,6 +267,7 @@ HEADERS += TSessionStore \
            TSqlQueryORMapper \
            TSqlQueryORMapperIterator \
            TSqlTransaction \
+           TSqlResultCache \
            TCookieJar \
            TSession \
            THtmlParser \
@@ -6,6 +6,7 @@
  */
 
 #include "taccesslog.h"
+#include "tlayoututil.h"
 
 /*!
   \class TAccessLog
@@ -14,70 +15,196 @@
 */
 
 TAccessLog::TAccessLog()
-    : statusCode(0), responseBytes(0)
+    : statusCode(0), responseBytes(0), beganTransactions(0), committedTransactions(0), rolledBackTransactions(0),
+      totalTime(0), readTime(0), routingTime(0), sessionTime(0), controllerTime(0), renderTime(0),
+      sqlQueryTime(0), sqlQueryCount(0), writeTime(0)
 { }
 
 
 TAccessLog::TAccessLog(const QByteArray &host, const QByteArray &req)
-    : timestamp(QDateTime::currentDateTime()), remoteHost(host), request(req), statusCode(0), responseBytes(0)
+    : timestamp(QDateTime::currentDateTime()), remoteHost(host), request(req), statusCode(0), responseBytes(0),
+      beganTransactions(0), committedTransactions(0), rolledBackTransactions(0),
+      totalTime(0), readTime(0), routingTime(0), sessionTime(0), controllerTime(0), renderTime(0),
+      sqlQueryTime(0), sqlQueryCount(0), writeTime(0)
 { }
 
 
+/*!
+  Returns the log formatted with the \a layout and \a dateTimeFormat.
+  The layout is parsed on each call; use the TAccessLogLayout overload
+  to format many logs with the same layout.
+*/
 QByteArray TAccessLog::toByteArray(const QByteArray &layout, const QByteArray &dateTimeFormat) const
 {
+    return TAccessLogLayout(layout, dateTimeFormat).format(*this);
+}
+
+/*!
+  Returns the log formatted with the precompiled \a layout.
+*/
+QByteArray TAccessLog::toByteArray(const TAccessLogLayout &layout) const
+{
+    return layout.format(*this);
+}
+
+
+/*!
+  \class TAccessLogLayout
+  \brief The TAccessLogLayout class is a layout of the access log,
+  which is parsed once into the list of the elements.
+*/
+
+TAccessLogLayout::TAccessLogLayout()
+    : logFormat(Text)
+{ }
+
+
+TAccessLogLayout::TAccessLogLayout(const QByteArray &layout, const QByteArray &format, Format fmt)
+    : dateTimeFormat(format), logFormat(fmt)
+{
+    tParseLayout(layout, "hdrsOxDIUSCVQqW", elements);
+}
+
+/*!
+  Returns the \a log formatted with this layout.
+*/
+QByteArray TAccessLogLayout::format(const TAccessLog &log) const
+{
+    if (logFormat == JsonLines)
+        return toJson(log);
+
     QByteArray message;
-    int pos = 0;
-    while (pos < layout.length()) {
-        char c = layout.at(pos++);
-        if (c != '%') {
-            message.append(c);
-            continue;
-        }
-        
-        QByteArray dig;
-        for (;;) {
-            if (pos >= layout.length()) {
-                message.append('%').append(dig);
-                break;
-            }
-            
-            c = layout.at(pos++);
-            if (c >= '0' && c <= '9') {
-                dig += c;
-                continue;
-            }
-
-            if (c == 'h') {
-                message.append(remoteHost);
-
-            } else if (c == 'd') {  // %d : timestamp
-                if (!dateTimeFormat.isEmpty()) {
-                    message.append(timestamp.toString(dateTimeFormat).toLocal8Bit());
-                } else {
-                    message.append(timestamp.toString(Qt::ISODate).toLatin1());
-                }
-
-            } else if (c == 'r') {
-                message.append(request);
-
-            } else if (c == 's') {
-                message.append(QString::number(statusCode));
-
-            } else if (c == 'O') {
-                message.append(QString::number(responseBytes));
-
-            } else if (c == 'n') {  // %n : newline
-                message.append('\n');
-
-            } else if (c == '%') {
-                message.append('%').append(dig);
-                dig.clear();
-                continue;
-            } else {
-                message.append('%').append(dig).append(c);
-            }
+    message.reserve(256);
+
+    for (QVectorIterator<Element> it(elements); it.hasNext(); ) {
+        const Element &e = it.next();
+        switch (e.conversion) {
+        case 0:
+            message.append(e.text);
+            break;
+
+        case 'h':
+            message.append(log.remoteHost);
+            break;
+
+        case 'd':  // %d : timestamp
+            tAppendTimestamp(message, log.timestamp, dateTimeFormat);
+            break;
+
+        case 'r':
+            message.append(log.request);
+            break;
+
+        case 's':
+            message.append(QByteArray::number(log.statusCode));
+            break;
+
+        case 'O':
+            message.append(QByteArray::number(log.responseBytes));
+            break;
+
+        case 'x':  // %x : transactions, began/committed/rolled back
+            message.append(QByteArray::number(log.beganTransactions)).append('/');
+            message.append(QByteArray::number(log.committedTransactions)).append('/');
+            message.append(QByteArray::number(log.rolledBackTransactions));
+            break;
+
+        case 'D':  // %D : total time in microseconds
+            message.append(QByteArray::number(log.totalTime));
+            break;
+
+        case 'I':  // %I : time to read the request
+            message.append(QByteArray::number(log.readTime));
+            break;
+
+        case 'U':  // %U : time of URL routing
+            message.append(QByteArray::number(log.routingTime));
+            break;
+
+        case 'S':  // %S : time to load and store the session
+            message.append(QByteArray::number(log.sessionTime));
+            break;
+
+        case 'C':  // %C : time of the controller, including rendering and SQL
+            message.append(QByteArray::number(log.controllerTime));
+            break;
+
+        case 'V':  // %V : time of view rendering
+            message.append(QByteArray::number(log.renderTime));
+            break;
+
+        case 'Q':  // %Q : time of SQL queries
+            message.append(QByteArray::number(log.sqlQueryTime));
+            break;
+
+        case 'q':  // %q : number of SQL queries
+            message.append(QByteArray::number(log.sqlQueryCount));
+            break;
+
+        case 'W':  // %W : time to write the response
+            message.append(QByteArray::number(log.writeTime));
+            break;
+
+        default:
             break;
         }
     }
     return message;
 }
+
+/*
+  Appends the string value escaped for JSON.
+*/
+static void appendJsonString(QByteArray &json, const QByteArray &str)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    json.append('"');
+    for (int i = 0; i < str.length(); ++i) {
+        uchar c = str.at(i);
+        if (c == '"' || c == '\\') {
+            json.append('\\').append((char)c);
+        } else if (c < 0x20) {
+            json.append("\\u00").append(hex[c >> 4]).append(hex[c & 0xf]);
+        } else {
+            json.append((char)c);
+        }
+    }
+    json.append('"');
+}
+
+/*
+  Returns the log as a JSON object in a line, which contains all the
+  fields regardless of the layout.
+*/
+QByteArray TAccessLogLayout::toJson(const TAccessLog &log) const
+{
+    QByteArray json;
+    json.reserve(512);
+
+    // The date-time format can contain quotes and backslashes
+    QByteArray time;
+    tAppendTimestamp(time, log.timestamp, dateTimeFormat);
+    json.append("{\"time\":");
+    appendJsonString(json, time);
+    json.append(",\"host\":");
+    appendJsonString(json, log.remoteHost);
+    json.append(",\"request\":");
+    appendJsonString(json, log.request);
+    json.append(",\"status\":").append(QByteArray::number(log.statusCode));
+    json.append(",\"bytes\":").append(QByteArray::number(log.responseBytes));
+    json.append(",\"transactions\":[").append(QByteArray::number(log.beganTransactions));
+    json.append(',').append(QByteArray::number(log.committedTransactions));
+    json.append(',').append(QByteArray::number(log.rolledBackTransactions)).append(']');
+    json.append(",\"total\":").append(QByteArray::number(log.totalTime));
+    json.append(",\"read\":").append(QByteArray::number(log.readTime));
+    json.append(",\"routing\":").append(QByteArray::number(log.routingTime));
+    json.append(",\"session\":").append(QByteArray::number(log.sessionTime));
+    json.append(",\"controller\":").append(QByteArray::number(log.controllerTime));
+    json.append(",\"render\":").append(QByteArray::number(log.renderTime));
+    json.append(",\"sql\":").append(QByteArray::number(log.sqlQueryTime));
+    json.append(",\"queries\":").append(QByteArray::number(log.sqlQueryCount));
+    json.append(",\"write\":").append(QByteArray::number(log.writeTime));
+    json.append("}\n");
+    return json;
+}
@@ -3,8 +3,11 @@
 
 #include <QDateTime>
 #include <QByteArray>
+#include <QVector>
 #include <TGlobal>
 
+class TAccessLogLayout;
+
 
 class T_CORE_EXPORT TAccessLog
 {
@@ -12,12 +15,54 @@ public:
     TAccessLog();
     TAccessLog(const QByteArray &remoteHost, const QByteArray &request);
     QByteArray toByteArray(const QByteArray &layout, const QByteArray &dateTimeFormat) const;
+    QByteArray toByteArray(const TAccessLogLayout &layout) const;
 
     QDateTime timestamp;
     QByteArray remoteHost;
     QByteArray request;
     int statusCode;
     int responseBytes;
+    int beganTransactions;
+    int committedTransactions;
+    int rolledBackTransactions;
+    qint64 totalTime;       // in microseconds
+    qint64 readTime;
+    qint64 routingTime;
+    qint64 sessionTime;
+    qint64 controllerTime;
+    qint64 renderTime;
+    qint64 sqlQueryTime;
+    int sqlQueryCount;
+    qint64 writeTime;
+};
+
+
+class T_CORE_EXPORT TAccessLogLayout
+{
+public:
+    enum Format {
+        Text = 0,
+        JsonLines,
+    };
+
+    TAccessLogLayout();
+    TAccessLogLayout(const QByteArray &layout, const QByteArray &dateTimeFormat, Format format = Text);
+    QByteArray format(const TAccessLog &log) const;
+
+private:
+    struct Element
+    {
+        char conversion;  // 0 for the literal text
+        int width;        // not used
+        char fillChar;    // not used
+        QByteArray text;
+    };
+
+    QByteArray toJson(const TAccessLog &log) const;
+
+    QVector<Element> elements;
+    QByteArray dateTimeFormat;
+    Format logFormat;
 };
 
 #endif // TACCESSLOG_H
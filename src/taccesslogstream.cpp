@@ -6,6 +6,7 @@
  */
 
 #include <QSystemSemaphore>
+#include <QTimerEvent>
 #include <QFileInfo>
 #include <TWebApplication>
 #include <TSystemGlobal>
@@ -18,21 +19,41 @@
 */
 
 
-TAccessLogStream::TAccessLogStream(const QString &fileName)
-    : logger(new TFileLogger), semaphore(0)
+const int MAX_BUFFER_SIZE = 64 * 1024;
+
+/*!
+  Constructs a stream writing to the file \a fileName. If
+  \a flushInterval is more than 0, the logs are buffered and written
+  every \a flushInterval milliseconds, or when the buffer is full.
+*/
+TAccessLogStream::TAccessLogStream(const QString &fileName, int flushInterval)
+    : QObject(), logger(new TFileLogger), semaphore(0)
 {
     logger->setFileName(fileName);
-    
+
+#if defined(Q_OS_WIN)
     if (Tf::app()->multiProcessingModule() == TWebApplication::Prefork) {
         semaphore = new QSystemSemaphore(QLatin1String("TreeFrog_") + QFileInfo(fileName).fileName(), 1, QSystemSemaphore::Open);
     } else {
         logger->open();
     }
+#else
+    // Opened in the append mode; a write of a buffer is appended
+    // atomically even if the file is shared with the other processes
+    logger->open();
+#endif
+
+    if (flushInterval > 0) {
+        buffer.reserve(MAX_BUFFER_SIZE);
+        flushTimer.start(flushInterval, this);
+    }
 }
 
 
 TAccessLogStream::~TAccessLogStream()
 {
+    flushTimer.stop();
+    flush();
     delete logger;
     if (semaphore)
         delete semaphore;
@@ -40,13 +61,51 @@ TAccessLogStream::~TAccessLogStream()
 
 
 void TAccessLogStream::writeLog(const QByteArray &log)
+{
+    if (!flushTimer.isActive()) {
+        writeBuffer(log);
+        return;
+    }
+
+    bufferMutex.lock();
+    buffer.append(log);
+    bool full = (buffer.length() >= MAX_BUFFER_SIZE);
+    bufferMutex.unlock();
+
+    if (full) {
+        flush();
+    }
+}
+
+/*!
+  Writes the buffered logs to the file.
+*/
+void TAccessLogStream::flush()
+{
+    QMutexLocker locker(&writeMutex);  // keeps the order of the buffers
+
+    bufferMutex.lock();
+    QByteArray buf = buffer;
+    buffer = QByteArray();
+    if (flushTimer.isActive()) {
+        buffer.reserve(MAX_BUFFER_SIZE);
+    }
+    bufferMutex.unlock();
+
+    if (!buf.isEmpty()) {
+        writeBuffer(buf);
+    }
+}
+
+
+void TAccessLogStream::writeBuffer(const QByteArray &buf)
 {
     if (semaphore) {
         semaphore->acquire();
         logger->open();
     }
     
-    logger->log(log);
+    logger->log(buf);
     logger->flush();
     
     if (semaphore) {
@@ -54,3 +113,13 @@ void TAccessLogStream::writeLog(const QByteArray &log)
         semaphore->release();
     }
 }
+
+
+void TAccessLogStream::timerEvent(QTimerEvent *event)
+{
+    if (event->timerId() == flushTimer.timerId()) {
+        flush();
+    } else {
+        QObject::timerEvent(event);
+    }
+}
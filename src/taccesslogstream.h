@@ -1,20 +1,33 @@
 #ifndef TACCESSLOGSTREAM_H
 #define TACCESSLOGSTREAM_H
 
+#include <QObject>
+#include <QMutex>
+#include <QBasicTimer>
+
 class QSystemSemaphore;
 class TFileLogger;
 
 
-class TAccessLogStream
+class TAccessLogStream : public QObject
 {
 public:
-    TAccessLogStream(const QString &fileName);
+    TAccessLogStream(const QString &fileName, int flushInterval = 0);
     ~TAccessLogStream();
     void writeLog(const QByteArray &log);
+    void flush();
+
+protected:
+    void writeBuffer(const QByteArray &buf);
+    void timerEvent(QTimerEvent *event);
 
 private:
     TFileLogger *logger;
     QSystemSemaphore *semaphore;
+    QByteArray buffer;
+    QMutex bufferMutex;
+    QMutex writeMutex;
+    QBasicTimer flushTimer;
     
     TAccessLogStream(const TAccessLogStream &);
     TAccessLogStream &operator=(const TAccessLogStream &);
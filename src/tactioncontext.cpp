@@ -11,27 +11,26 @@
 #include <QHostAddress>
 #include <TActionContext>
 #include <TWebApplication>
+#include <TAppSettings>
 #include <THttpRequest>
 #include <THttpResponse>
 #include <THttpUtility>
 #include <TDispatcher>
 #include <TActionController>
 #include <TSqlDatabasePool>
+#include <TSqlResultCache>
 #include <TSessionStore>
+#include <TMetrics>
 #include "tsystemglobal.h"
 #include "thttpsocket.h"
 #include "tsessionmanager.h"
 #include "turlroute.h"
 #include "taccesslog.h"
+#include <ctype.h>
 #ifdef Q_OS_UNIX
 # include "tfcore_unix.h"
 #endif
 
-#define AUTO_ID_REGENERATION  "Session.AutoIdRegeneration"
-#define DIRECT_VIEW_RENDER_MODE  "DirectViewRenderMode"
-#define ENABLE_CSRF_PROTECTION_MODULE "EnableCsrfProtectionModule"
-#define SESSION_COOKIE_PATH  "Session.CookiePath"
-#define LISTEN_PORT  "ListenPort"
 
 /*!
   \class TActionContext
@@ -41,7 +40,8 @@
 
 
 TActionContext::TActionContext(int socket)
-    : sqlDatabases(Tf::app()->databaseSettingsCount() + 1), stopped(false), socketDesc(socket), httpSocket(0), currController(0)
+    : sqlDatabases(Tf::app()->databaseSettingsCount() + 1), replicaDatabases(Tf::app()->databaseSettingsCount()), stopped(false), socketDesc(socket), httpSocket(0), currController(0),
+      readOnlyAction(false), sqlQueryTime(0), sqlQueryCount(0), renderTime(0)
 { }
 
 
@@ -66,17 +66,118 @@ TActionContext::~TActionContext()
 }
 
 
+/*
+  Returns true if the request has the bearer token of the metrics.
+  The comparison takes the same time wherever the token differs.
+*/
+static bool isMetricsAuthorized(const THttpRequestHeader &header)
+{
+    const QByteArray &token = Tf::app()->settings().metricsToken;
+    if (token.isEmpty())
+        return false;
+
+    QByteArray auth = header.rawHeader("Authorization").trimmed();
+    if (!auth.startsWith("Bearer "))
+        return false;
+
+    QByteArray value = auth.mid(7).trimmed();
+    if (value.length() != token.length())
+        return false;
+
+    char diff = 0;
+    for (int i = 0; i < token.length(); ++i) {
+        diff |= value[i] ^ token[i];
+    }
+    return diff == 0;
+}
+
+
+static void observeCheckout(int id, const char *role, qint64 startTime)
+{
+    if (TMetrics::isEnabled()) {
+        QByteArray labels = TMetrics::label("database", QByteArray::number(id)) + ',' + TMetrics::label("role", role);
+        TMetrics::observe("tf_db_pool_checkout_seconds", labels, tMicroseconds() - startTime);
+    }
+}
+
+/*!
+  Returns the database connection to write to the database \a id.
+  A transaction is begun on the first call of this function, so that
+  requests which only read the database issue no BEGIN and COMMIT.
+*/
 QSqlDatabase &TActionContext::getDatabase(int id)
 {
     T_TRACEFUNC("id:%d", id);
 
+    QSqlDatabase &db = getPrimaryDatabase(id);
+    if (db.isValid() && !transactions.isActive(id)) {
+        beginTransaction(db);
+    }
+    return db;
+}
+
+/*!
+  Returns the connection to the primary database \a id without
+  beginning a transaction.
+*/
+QSqlDatabase &TActionContext::getPrimaryDatabase(int id)
+{
+    T_TRACEFUNC("id:%d", id);
+
     if (id < 0 || id >= Tf::app()->databaseSettingsCount())
         return sqlDatabases[Tf::app()->databaseSettingsCount()];  // invalid db
     
     QSqlDatabase &db = sqlDatabases[id];
     if (!db.isValid()) {
+        qint64 startTime = tMicroseconds();
         db = TSqlDatabasePool::instance()->pop(id);
-        beginTransaction(db);
+        observeCheckout(id, "primary", startTime);
+    }
+    return db;
+}
+
+
+/*!
+  Returns true if the SQL result cache can be used for the database
+  \a id; otherwise returns false. The cache is bypassed while this
+  context has a write transaction of the database, since the results
+  include the uncommitted changes.
+*/
+bool TActionContext::isSqlResultCacheAvailable(int id) const
+{
+    return TSqlResultCache::instance().isAvailable() && !transactions.isActive(id);
+}
+
+
+/*!
+  Returns a database connection for read-only queries. If the action
+  is one of the read-only actions and the database \a id has replica
+  hosts, the connection to a replica is returned, unless the primary
+  database has been already used in this context so that the reads see
+  the uncommitted writes. In the other actions, the connection to the
+  primary database is returned, so that the reads before writing never
+  see stale records of a replica.
+  \sa TActionController::readOnlyActions()
+*/
+QSqlDatabase &TActionContext::getReadDatabase(int id)
+{
+    T_TRACEFUNC("id:%d", id);
+
+    if (id < 0 || id >= Tf::app()->databaseSettingsCount())
+        return sqlDatabases[Tf::app()->databaseSettingsCount()];  // invalid db
+
+    if (!readOnlyAction || sqlDatabases[id].isValid() || !TSqlDatabasePool::instance()->hasReplica(id))
+        return getPrimaryDatabase(id);
+
+    QSqlDatabase &db = replicaDatabases[id];
+    if (!db.isValid()) {
+        qint64 startTime = tMicroseconds();
+        db = TSqlDatabasePool::instance()->popReplica(id);
+        observeCheckout(id, "replica", startTime);
+        if (!db.isValid()) {
+            // No replica available
+            return getPrimaryDatabase(id);
+        }
     }
     return db;
 }
@@ -89,6 +190,10 @@ void TActionContext::releaseDatabases()
     for (int i = 0; i < sqlDatabases.count(); ++i) {
         TSqlDatabasePool::instance()->push(sqlDatabases[i]);
     }
+
+    for (int i = 0; i < replicaDatabases.count(); ++i) {
+        TSqlDatabasePool::instance()->push(replicaDatabases[i]);
+    }
 }
 
 
@@ -97,6 +202,9 @@ void TActionContext::execute()
     T_TRACEFUNC();
     TAccessLog accessLog;
     THttpResponseHeader responseHeader;
+    qint64 startTime = tMicroseconds();
+    qint64 lap = startTime;
+    QByteArray actionLabel;
 
     try {
         httpSocket = new THttpSocket;
@@ -132,12 +240,14 @@ void TActionContext::execute()
 
         THttpRequest httpRequest = httpSocket->read();
         const THttpRequestHeader &hdr = httpRequest.header();
+        lap = tMicroseconds();
+        accessLog.readTime = lap - startTime;
 
         // Access log
         QByteArray firstLine = hdr.method() + ' ' + hdr.path();
         firstLine += QString(" HTTP/%1.%2").arg(hdr.majorVersion()).arg(hdr.minorVersion()).toLatin1();
         accessLog.request = firstLine;
-        accessLog.remoteHost = (Tf::app()->appSettings().value(LISTEN_PORT).toUInt() > 0) ? httpSocket->peerAddress().toString().toLatin1() : QByteArray("(unix)");
+        accessLog.remoteHost = (Tf::app()->settings().listenPort > 0) ? httpSocket->peerAddress().toString().toLatin1() : QByteArray("(unix)");
 
         tSystemDebug("method : %s", hdr.method().data());
         tSystemDebug("path : %s", hdr.path().data());
@@ -161,7 +271,7 @@ void TActionContext::execute()
             }
 
             // Direct view render mode?
-            if (Tf::app()->appSettings().value(DIRECT_VIEW_RENDER_MODE).toBool()) {
+            if (Tf::app()->settings().directViewRenderMode) {
                 // Direct view setting
                 rt.controller = "directcontroller";
                 rt.action = "show";
@@ -181,26 +291,33 @@ void TActionContext::execute()
         // Call controller method
         TDispatcher<TActionController> ctlrDispatcher(rt.controller);
         currController = ctlrDispatcher.object();
+        accessLog.routingTime = tMicroseconds() - lap;
+        // The action from the URL is labeled only after dispatched, so that
+        // the metrics don't have a series for each invalid URL
+        actionLabel = (currController) ? QByteArray("(unknown)") : QByteArray("(static)");
+
         if (currController) {
             currController->setActionName(rt.action);
             currController->setHttpRequest(httpRequest);
             
             // Session
+            TSession foundSession;
             if (currController->sessionEnabled()) {
-                TSession session;
+                lap = tMicroseconds();
                 QByteArray sessionId = httpRequest.cookie(TSession::sessionName());
                 if (!sessionId.isEmpty()) {
                     // Finds a session
-                    session = TSessionManager::instance().findSession(sessionId);
+                    foundSession = TSessionManager::instance().findSession(sessionId);
                 }
-                currController->setSession(session);
+                currController->setSession(foundSession);
                 
                 // Exports flash-variant
                 currController->exportAllFlashVariants();
+                accessLog.sessionTime += tMicroseconds() - lap;
             }
             
             // Verify authenticity token
-            if (Tf::app()->appSettings().value(ENABLE_CSRF_PROTECTION_MODULE, true).toBool()
+            if (Tf::app()->settings().enableCsrfProtectionModule
                 && currController->csrfProtectionEnabled() && !currController->exceptionActionsOfCsrfProtection().contains(rt.action)) {
 
                 if (method == Tf::Post || method == Tf::Put || method == Tf::Delete) {
@@ -211,7 +328,7 @@ void TActionContext::execute()
             }
 
             if (currController->sessionEnabled()) {
-                if (currController->session().id().isEmpty() || Tf::app()->appSettings().value(AUTO_ID_REGENERATION).toBool()) {
+                if (currController->session().id().isEmpty() || Tf::app()->settings().sessionAutoIdRegeneration) {
                     TSessionManager::instance().remove(currController->session().sessionId); // Removes the old session
                     // Re-generate session ID
                     currController->session().sessionId = TSessionManager::instance().generateId();
@@ -222,18 +339,22 @@ void TActionContext::execute()
             }
 
             // Database Transaction
-            transactions.setEnabled(currController->transactionEnabled());
+            readOnlyAction = currController->readOnlyActions().contains(rt.action);
+            transactions.setEnabled(currController->transactionEnabled() && !readOnlyAction);
             
             // Do filters
+            lap = tMicroseconds();
             if (currController->preFilter()) {
                 
                 // Dispathes
                 bool dispatched = ctlrDispatcher.invoke(rt.action, rt.params);
                 if (dispatched) {
+                    actionLabel = rt.controller + '.' + rt.action;
                     autoRemoveFiles << currController->autoRemoveFiles;  // Adds auto-remove files
                     
                     // Post fileter
                     currController->postFilter();
+                    accessLog.controllerTime = tMicroseconds() - lap;
                     
                     if (currController->rollbackRequested()) {
                         rollbackTransactions();
@@ -241,10 +362,21 @@ void TActionContext::execute()
                         // Commits a transaction to the database
                         commitTransactions();
                     }
+                    // Writes after here are committed automatically
+                    transactions.setEnabled(false);
                     
                     // Session store
                     if (currController->sessionEnabled()) {
-                        bool stored = TSessionManager::instance().store(currController->session());
+                        lap = tMicroseconds();
+                        TSession &session = currController->session();
+                        bool stored;
+                        if (!foundSession.id().isEmpty() && session.id() == foundSession.id()
+                            && *static_cast<const QVariantHash *>(&session) == *static_cast<const QVariantHash *>(&foundSession)) {
+                            // Not modified
+                            stored = TSessionManager::instance().touch(session);
+                        } else {
+                            stored = TSessionManager::instance().store(session);
+                        }
                         if (stored) {
                             QDateTime expire;
                             if (TSessionManager::sessionLifeTime() > 0) {
@@ -252,9 +384,10 @@ void TActionContext::execute()
                             }
                             
                             // Sets the path in the session cookie
-                            QString cookiePath = Tf::app()->appSettings().value(SESSION_COOKIE_PATH).toString();
+                            const QString &cookiePath = Tf::app()->settings().sessionCookiePath;
                             currController->addCookie(TSession::sessionName(), currController->session().id(), expire, cookiePath);
                         }
+                        accessLog.sessionTime += tMicroseconds() - lap;
                     }
                 }
             }
@@ -264,8 +397,10 @@ void TActionContext::execute()
             currController->response.header().setStatusLine(accessLog.statusCode, THttpUtility::getResponseReasonPhrase(accessLog.statusCode));
 
             // Writes a response and access log
+            lap = tMicroseconds();
             accessLog.responseBytes = writeResponse(currController->response.header(), currController->response.bodyIODevice(),
                                                     currController->response.bodyLength());
+            accessLog.writeTime = tMicroseconds() - lap;
             
             httpSocket->disconnectFromHost();
 
@@ -274,8 +409,23 @@ void TActionContext::execute()
         
         } else {
             accessLog.statusCode = Tf::BadRequest;
+            lap = tMicroseconds();
+
+            if (method == Tf::Get && Tf::app()->settings().metricsEnabled
+                && path == QLatin1String(Tf::app()->settings().metricsPath)) {
+                // Metrics of this server
+                actionLabel = "(metrics)";
+                if (isMetricsAuthorized(hdr)) {
+                    QByteArray metrics = TMetrics::exposition();
+                    QBuffer buf(&metrics);
+                    accessLog.responseBytes = writeResponse(Tf::OK, responseHeader, "text/plain; version=0.0.4", &buf, metrics.length());
+                } else {
+                    accessLog.responseBytes = writeResponse(Tf::Forbidden, responseHeader);
+                }
+                accessLog.statusCode = responseHeader.statusCode();
+                accessLog.writeTime = tMicroseconds() - lap;
 
-            if (method == Tf::Get) {  // GET Method
+            } else if (method == Tf::Get) {  // GET Method
                 path.remove(0, 1);
                 QFile reqPath(Tf::app()->publicPath() + path);
                 QFileInfo fi(reqPath);
@@ -303,6 +453,7 @@ void TActionContext::execute()
                     accessLog.responseBytes = writeResponse(Tf::NotFound, responseHeader);
                 }
                 accessLog.statusCode = responseHeader.statusCode();
+                accessLog.writeTime = tMicroseconds() - lap;
 
             } else if (method == Tf::Post) {
                 // file upload?
@@ -325,9 +476,24 @@ void TActionContext::execute()
         tError("Caught Exception");
     }
 
+    rollbackTransactions();
+    accessLog.beganTransactions = transactions.beganCount();
+    accessLog.committedTransactions = transactions.committedCount();
+    accessLog.rolledBackTransactions = transactions.rolledBackCount();
+    accessLog.renderTime = renderTime;
+    accessLog.sqlQueryTime = sqlQueryTime;
+    accessLog.sqlQueryCount = sqlQueryCount;
+    accessLog.totalTime = tMicroseconds() - startTime;
+
     accessLog.timestamp = QDateTime::currentDateTime();
     writeAccessLog(accessLog);  // Writes access log
 
+    if (TMetrics::isEnabled() && !actionLabel.isEmpty()) {
+        QByteArray action = TMetrics::label("action", actionLabel);
+        TMetrics::increment("tf_http_requests_total", action + ',' + TMetrics::label("status", QByteArray::number(accessLog.statusCode)));
+        TMetrics::observe("tf_http_request_duration_seconds", action, accessLog.totalTime);
+    }
+
     // Push to the pool
     TActionContext::releaseDatabases();
 
@@ -338,6 +504,91 @@ void TActionContext::execute()
 }
 
 
+/*
+  Returns the shape of the SQL \a query, in which the literals are
+  replaced with '?' and the lists of values are collapsed, so that the
+  statistics of the queries which differ only in values are aggregated.
+*/
+static QByteArray queryShape(const QString &query)
+{
+    static const int maxLength = 256;
+    const QByteArray sql = query.toUtf8();
+    QByteArray shape;
+    shape.reserve(qMin(sql.length(), maxLength) + 3);
+
+    int i = 0;
+    while (i < sql.length() && shape.length() < maxLength) {
+        char c = sql[i];
+        bool literal = false;
+
+        if (c == '\'') {
+            // String literal
+            for (++i; i < sql.length(); ++i) {
+                if (sql[i] == '\\') {
+                    ++i;
+                } else if (sql[i] == '\'') {
+                    if (i + 1 < sql.length() && sql[i + 1] == '\'') {
+                        ++i;
+                    } else {
+                        break;
+                    }
+                }
+            }
+            ++i;
+            literal = true;
+        } else if (isdigit((uchar)c) && (shape.isEmpty() || !(isalnum((uchar)shape[shape.length() - 1]) || shape.endsWith('_')))) {
+            // Numeric literal
+            while (i < sql.length() && (isalnum((uchar)sql[i]) || sql[i] == '.')) {
+                ++i;
+            }
+            literal = true;
+        } else if (isspace((uchar)c)) {
+            if (!shape.isEmpty() && !shape.endsWith(' '))
+                shape += ' ';
+            ++i;
+        } else {
+            shape += c;
+            ++i;
+        }
+
+        if (literal) {
+            // Collapses a list of values such as "IN (?, ?, ?)"
+            if (shape.endsWith("?, ")) {
+                shape.chop(2);
+            } else if (shape.endsWith("?,")) {
+                shape.chop(1);
+            } else {
+                shape += '?';
+            }
+        }
+    }
+
+    if (i < sql.length())
+        shape += "...";
+    return shape;
+}
+
+/*!
+  Adds the SQL \a query which took \a usecs microseconds to the
+  statistics of this context, and writes it to the SQL query log.
+*/
+void TActionContext::addSqlQuery(const QString &query, qint64 usecs, bool succeeded)
+{
+    sqlQueryTime += usecs;
+    ++sqlQueryCount;
+
+    QString caller;
+    if (currController && Tf::app()->settings().sqlQuerySlowThreshold > 0) {
+        caller = currController->name() + QLatin1Char('#') + currController->activeAction();
+    }
+    tQueryLog(usecs, (succeeded ? query : QLatin1String("(Query failed) ") + query), caller);
+
+    if (TMetrics::isEnabled()) {
+        TMetrics::observe("tf_sql_query_duration_seconds", TMetrics::label("shape", queryShape(query)), usecs);
+    }
+}
+
+
 qint64 TActionContext::writeResponse(int statusCode, THttpResponseHeader &header)
 {
     T_TRACEFUNC("statusCode:%d", statusCode);
@@ -23,11 +23,17 @@ public:
     virtual ~TActionContext();
 
     QSqlDatabase &getDatabase(int id);
+    QSqlDatabase &getPrimaryDatabase(int id);
+    QSqlDatabase &getReadDatabase(int id);
     void releaseDatabases();
     TTemporaryFile &createTemporaryFile();
     void stop() { stopped = true; }
     QHostAddress clientAddress() const;
     const TActionController *currentController() const { return currController; }
+    void addSqlQuery(const QString &query, qint64 usecs, bool succeeded = true);
+    void addRenderTime(qint64 usecs) { renderTime += usecs; }
+    void addModifiedTable(int databaseId, const QString &table) { transactions.addModifiedTable(databaseId, table); }
+    bool isSqlResultCacheAvailable(int databaseId) const;
     static TActionContext *current();
 
 protected:
@@ -43,6 +49,7 @@ protected:
     qint64 writeResponse(THttpResponseHeader &header, QIODevice *body, qint64 length);
 
     QVector<QSqlDatabase> sqlDatabases;
+    QVector<QSqlDatabase> replicaDatabases;
     TSqlTransaction transactions;
     volatile bool stopped;
 
@@ -52,8 +59,12 @@ private:
     int socketDesc;
     THttpSocket *httpSocket;
     TActionController *currController;
+    bool readOnlyAction;
     QList<TTemporaryFile *> tempFiles;
     QStringList autoRemoveFiles;
+    qint64 sqlQueryTime;  // in microseconds
+    int sqlQueryCount;
+    qint64 renderTime;
 };
 
 #endif // TACTIONCONTEXT_H
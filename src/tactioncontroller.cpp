@@ -13,6 +13,7 @@
 #include <QCryptographicHash>
 #include <TActionController>
 #include <TWebApplication>
+#include <TAppSettings>
 #include <TDispatcher>
 #include <TActionView>
 #include <TSession>
@@ -20,12 +21,26 @@
 #include <TActionContext>
 #include <TFormValidator>
 #include "tsessionmanager.h"
+#include "tsystemglobal.h"
 #include "ttextview.h"
 
-#define STORE_TYPE              "Session.StoreType"
 #define FLASH_VARS_SESSION_KEY  "_flashVariants"
 #define LOGIN_USER_NAME_KEY     "_loginUserName"
-#define CSRF_PROTECTION_KEY     "Session.CsrfProtectionKey"
+
+/*
+  Adds the time of rendering to the action context when it goes out
+  of scope.
+*/
+class TRenderTimeCounter
+{
+public:
+    TRenderTimeCounter() : context(TActionContext::current()), start(tMicroseconds()) { }
+    ~TRenderTimeCounter() { context->addRenderTime(tMicroseconds() - start); }
+
+private:
+    TActionContext *context;
+    qint64 start;
+};
 
 /*!
   \class TActionController
@@ -202,8 +217,8 @@ bool TActionController::addCookie(const QByteArray &name, const QByteArray &valu
  */
 QByteArray TActionController::authenticityToken() const
 {
-    if (Tf::app()->appSettings().value(STORE_TYPE).toString().toLower() == QLatin1String("cookie")) {
-        QString key = Tf::app()->appSettings().value(CSRF_PROTECTION_KEY).toString();
+    if (Tf::app()->settings().sessionStoreType == QLatin1String("cookie")) {
+        const QString &key = Tf::app()->settings().sessionCsrfProtectionKey;
         QByteArray csrfId = session().value(key).toByteArray();
 
         if (csrfId.isEmpty()) {
@@ -211,7 +226,7 @@ QByteArray TActionController::authenticityToken() const
         }
         return csrfId;
     } else {
-        return QCryptographicHash::hash(session().id() + Tf::app()->appSettings().value("Session.Secret").toByteArray(), QCryptographicHash::Sha1).toHex();
+        return QCryptographicHash::hash(session().id() + Tf::app()->settings().sessionSecret, QCryptographicHash::Sha1).toHex();
     }
 }
 
@@ -237,8 +252,8 @@ void TActionController::setSession(const TSession &session)
 */
 void TActionController::setCsrfProtectionInto(TSession &session)
 {
-    if (Tf::app()->appSettings().value(STORE_TYPE).toString().toLower() == QLatin1String("cookie")) {
-        QString key = Tf::app()->appSettings().value(CSRF_PROTECTION_KEY).toString();
+    if (Tf::app()->settings().sessionStoreType == QLatin1String("cookie")) {
+        const QString &key = Tf::app()->settings().sessionCsrfProtectionKey;
         session.insert(key, TSessionManager::instance().generateId());  // it's just a random value
     }
 }
@@ -256,7 +271,7 @@ bool TActionController::verifyRequest(const THttpRequest &request) const
         return true;
     }
 
-    if (Tf::app()->appSettings().value(STORE_TYPE).toString().toLower() != QLatin1String("cookie")) {
+    if (Tf::app()->settings().sessionStoreType != QLatin1String("cookie")) {
         if (session().id().isEmpty()) {
             throw SecurityException("Request Forgery Protection requires a valid session", __FILE__, __LINE__);
         }
@@ -398,6 +413,7 @@ QString TActionController::getRenderingData(const QString &templateName, const Q
 QByteArray TActionController::renderView(TActionView *view)
 {
     T_TRACEFUNC("view: %p  layout: %s", view, qPrintable(layout()));
+    TRenderTimeCounter counter;
 
     if (!view) {
         tSystemError("view null pointer.  action:%s", qPrintable(activeAction()));
@@ -764,6 +780,16 @@ void TActionController::setFlashValidationErrors(const TFormValidator &v, const
   Must be overridden by subclasses to disable transaction mechanism.
   The function must return \a false to disable the mechanism. This function
   returns \a true.
+  \sa readOnlyActions()
+*/
+
+/*!
+  \fn virtual QStringList TActionController::readOnlyActions() const;
+
+  Must be overridden by subclasses to return a string list of actions
+  which only read the database. No transaction is begun in the actions,
+  and the ORM mappers read replica databases if available.
+  \sa transactionEnabled()
 */
 
 /*!
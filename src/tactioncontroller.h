@@ -35,6 +35,7 @@ public:
     virtual bool csrfProtectionEnabled() const { return true; }
     virtual QStringList exceptionActionsOfCsrfProtection() const { return QStringList(); }
     virtual bool transactionEnabled() const { return true; }
+    virtual QStringList readOnlyActions() const { return QStringList(); }
     QByteArray authenticityToken() const;
     QString flash(const QString &name) const;
     QHostAddress clientAddress() const;
@@ -5,18 +5,28 @@
  * the New BSD License, which is incorporated herein by reference.
  */
 
+#include <iostream>
 #include <QLibrary>
 #include <QDir>
+#include <QPointer>
+#include <QTimerEvent>
+#include <QFileInfo>
+#include <QDateTime>
 #include <TApplicationServer>
 #include <TWebApplication>
+#include <TAppSettings>
 #include <TActionThread>
 #include <TActionForkProcess>
 #include <TSqlDatabasePool>
 #include <TDispatcher>
 #include <TActionController>
 #include "turlroute.h"
+#include "tsessionmanager.h"
 #include "tsystemglobal.h"
 
+#define SESSION_GC_INTERVAL  "Session.GcInterval"
+#define MONITOR_INTERVAL     "Monitor.Interval"
+
 
 static void invokeStaticInitialize()
 {
@@ -54,6 +64,25 @@ protected:
     }
 };
 
+
+class TSessionGarbageCollector : public TActionThread
+{
+public:
+    TSessionGarbageCollector() : TActionThread(0) { }
+protected:
+    void run()
+    {
+        try {
+            TSessionManager::instance().removeGarbage();
+            commitTransactions();
+        } catch (...) {
+            tSystemError("Caught exception in session garbage collector");
+        }
+    }
+};
+
+static QPointer<TSessionGarbageCollector> sessionGc;
+
 /*!
   \class TApplicationServer
   \brief The TApplicationServer class provides functionality common to
@@ -61,15 +90,18 @@ protected:
 */
 
 static bool libLoaded = false;
+static QHash<QString, QDateTime> loadedLibraries;  // path, last modified
 
 
 TApplicationServer::TApplicationServer(QObject *parent)
-    : QTcpServer(parent)
+    : QTcpServer(parent), draining(false), requestCount(0), reportedRequestCount(0)
 {
     nativeSocketInit();
     
     maxServers = Tf::app()->maxNumberOfServers();
     connect(qApp, SIGNAL(aboutToQuit()), this, SLOT(terminate()));
+    connect(Tf::app(), SIGNAL(reloadRequested()), this, SLOT(reload()));
+    connect(Tf::app(), SIGNAL(gracefulShutdownRequested()), this, SLOT(drain()));
 }
 
 
@@ -84,7 +116,7 @@ bool TApplicationServer::open()
     T_TRACEFUNC();
 
     if (!isListening()) {
-        quint16 port = Tf::app()->appSettings().value("ListenPort").toUInt();
+        quint16 port = Tf::app()->settings().listenPort;
         int sock = nativeListen(QHostAddress::Any, port);
         if (sock > 0 && setSocketDescriptor(sock)) {
             tSystemDebug("listen successfully.  port:%d", port);
@@ -126,6 +158,7 @@ bool TApplicationServer::open()
             QLibrary lib(path);
             if (lib.load()) {
                 tSystemDebug("Library loaded: %s", qPrintable(path));
+                loadedLibraries.insert(path, QFileInfo(path).lastModified());
                 libLoaded = true;
             } else {
                 tSystemError("%s", qPrintable(lib.errorString()));
@@ -143,6 +176,22 @@ bool TApplicationServer::open()
         initializer->start();
         initializer->wait();
         delete initializer;
+
+        // Session GC in the background
+        int interval = Tf::app()->appSettings().value(SESSION_GC_INTERVAL, 60).toInt();
+        if (interval > 0 && !sessionGcTimer.isActive()) {
+            sessionGcTimer.start(interval * 1000, this);
+        }
+
+        // Reports the number of requests to tfmanager
+        int monitorInterval = Tf::app()->appSettings().value(MONITOR_INTERVAL, 60).toInt();
+        if (monitorInterval > 0 && !statusTimer.isActive()) {
+            statusTimer.start(monitorInterval * 1000, this);
+        }
+
+        // Ready to accept; the servers of the previous generation drain
+        // after all the servers have reported it
+        std::cerr << "_listening" << std::flush;  // send to tfmanager
         break; }
     
     case TWebApplication::Prefork: {
@@ -174,6 +223,8 @@ void TApplicationServer::close()
 
 void TApplicationServer::terminate()
 {
+    sessionGcTimer.stop();
+    statusTimer.stop();
     close();
   
     if (actionContextCount() > 0) {
@@ -194,6 +245,76 @@ void TApplicationServer::terminate()
 }
 
 
+/*!
+  Reloads the application settings and the routing table, which is
+  called when the server receives SIGHUP. Requests being processed
+  keep using the old ones until they finish.
+*/
+void TApplicationServer::reload()
+{
+    T_TRACEFUNC();
+    tSystemInfo("Reloading the settings and routes");
+
+    Tf::app()->reloadSettings();
+    if (!TUrlRoute::reload()) {
+        tSystemError("Failed to reload routes; the current routes are still used");
+    }
+
+    // Checks the application libraries
+    bool libUpdated = false;
+    for (QHashIterator<QString, QDateTime> it(loadedLibraries); it.hasNext(); ) {
+        it.next();
+        if (QFileInfo(it.key()).lastModified() != it.value()) {
+            libUpdated = true;
+            break;
+        }
+    }
+
+    if (libUpdated) {
+        switch (Tf::app()->multiProcessingModule()) {
+        case TWebApplication::Thread:
+            // Classes of the libraries can not be replaced in the process
+            tSystemWarn("Application libraries updated; restart the application servers to load them");
+            break;
+
+        case TWebApplication::Prefork:
+            // Exits if idle, so that tfmanager starts a new server
+            if (isListening() && actionContextCount() == 0) {
+                tSystemInfo("Application libraries updated; exiting to load them");
+                close();
+                QCoreApplication::exit(1);
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+
+/*!
+  Stops accepting new connections and exits after the requests in
+  progress have finished, which is called when the server receives
+  SIGQUIT. The listening socket remains open in the other processes
+  sharing it.
+*/
+void TApplicationServer::drain()
+{
+    T_TRACEFUNC();
+    tSystemInfo("Draining the application server");
+
+    draining = true;
+    sessionGcTimer.stop();
+    statusTimer.stop();
+    close();
+
+    if (actionContextCount() == 0) {
+        QCoreApplication::exit(0);
+    }
+}
+
+
 void TApplicationServer::incomingConnection(int socketDescriptor)
 {
     T_TRACEFUNC("socketDescriptor: %d", socketDescriptor);
@@ -206,6 +327,7 @@ void TApplicationServer::incomingConnection(int socketDescriptor)
                 connect(thread, SIGNAL(finished()), this, SLOT(deleteActionContext()));
                 insertPointer(thread);
                 thread->start();
+                ++requestCount;
                 break;
             }
             Tf::msleep(1);
@@ -233,6 +355,10 @@ void TApplicationServer::deleteActionContext()
     QMutexLocker locker(&setMutex);
     actionContexts.remove(reinterpret_cast<TActionThread *>(sender()));
     sender()->deleteLater();
+
+    if (draining && actionContexts.isEmpty()) {
+        QCoreApplication::exit(0);
+    }
 }
 
 
@@ -248,3 +374,23 @@ int TApplicationServer::actionContextCount() const
     QMutexLocker locker(&setMutex);
     return actionContexts.count();
 }
+
+
+void TApplicationServer::timerEvent(QTimerEvent *event)
+{
+    if (event->timerId() == sessionGcTimer.timerId()) {
+        if (!sessionGc && isListening()) {
+            sessionGc = new TSessionGarbageCollector();
+            connect(sessionGc, SIGNAL(finished()), this, SLOT(deleteActionContext()));
+            insertPointer(sessionGc);
+            sessionGc->start();
+        }
+    } else if (event->timerId() == statusTimer.timerId()) {
+        if (requestCount != reportedRequestCount) {
+            std::cerr << "_requests:" << requestCount << std::flush;  // send to tfmanager
+            reportedRequestCount = requestCount;
+        }
+    } else {
+        QTcpServer::timerEvent(event);
+    }
+}
@@ -4,6 +4,7 @@
 #include <QTcpServer>
 #include <QSet>
 #include <QMutex>
+#include <QBasicTimer>
 #include <TGlobal>
 
 class TActionContext;
@@ -26,6 +27,7 @@ public:
 
     static void nativeSocketInit();
     static void nativeSocketCleanup();
+    static int nativeBind(const QHostAddress &address, quint16 port, OpenFlag flag = CloseOnExec);
     static int nativeListen(const QHostAddress &address, quint16 port, OpenFlag flag = CloseOnExec);
     static int nativeListen(const QString &fileDomain, OpenFlag flag = CloseOnExec);
     static void nativeClose(int socket);
@@ -33,11 +35,14 @@ public:
 public slots:
     void close();
     void terminate();
+    void reload();
+    void drain();
 
 protected:
     virtual void incomingConnection(int socketDescriptor);
     void insertPointer(TActionContext *p);
     int actionContextCount() const;
+    void timerEvent(QTimerEvent *event);
 
 protected slots:
     void deleteActionContext();
@@ -46,6 +51,11 @@ private:
     int maxServers;
     QSet<TActionContext *> actionContexts;
     mutable QMutex setMutex;
+    QBasicTimer sessionGcTimer;
+    QBasicTimer statusTimer;
+    bool draining;
+    qint64 requestCount;
+    qint64 reportedRequestCount;
 
     Q_DISABLE_COPY(TApplicationServer)
 };
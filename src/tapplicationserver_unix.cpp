@@ -8,13 +8,22 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <QFile>
+#include <QSettings>
 #include <TApplicationServer>
+#include <TWebApplication>
 #include <TSystemGlobal>
 #include "tfcore_unix.h"
 
+#define REUSE_PORT    "MPM.thread.ReusePort"
+#define DEFER_ACCEPT  "TcpDeferAccept"
+#define FAST_OPEN     "TcpFastOpen"
+
 
 void TApplicationServer::nativeSocketInit()
 { }
@@ -23,31 +32,126 @@ void TApplicationServer::nativeSocketInit()
 void TApplicationServer::nativeSocketCleanup()
 { }
 
+/*!
+  Creates a socket and binds it to the \a address and \a port
+  without listening on it, so that a SO_REUSEPORT socket never joins
+  the group of the sockets listening on the port.
+  This function must be called in a tfmanager process.
+ */
+int TApplicationServer::nativeBind(const QHostAddress &address, quint16 port, OpenFlag flag)
+{
+    const QSettings &settings = Tf::app()->appSettings();
+    int on = 1;
+    int sd = ::socket((address.protocol() == QAbstractSocket::IPv6Protocol) ? AF_INET6 : AF_INET, SOCK_STREAM, 0);
+    if (sd < 0) {
+        tSystemError("Socket create failed  [%s:%d]", __FILE__, __LINE__);
+        return 0;
+    }
+
+    if (flag == CloseOnExec) {
+        ::fcntl(sd, F_SETFD, FD_CLOEXEC); // set close-on-exec flag
+    }
+    ::fcntl(sd, F_SETFL, ::fcntl(sd, F_GETFL) | O_NONBLOCK);  // non-block
+
+    // ReuseAddr
+    if (::setsockopt(sd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) < 0) {
+        tSystemError("setsockopt error  SO_REUSEADDR  errno:%d", errno);
+        goto socket_error;
+    }
+
+    // ReusePort
+    if (Tf::app()->multiProcessingModule() == TWebApplication::Thread
+        && settings.value(REUSE_PORT).toBool()) {
+#ifdef SO_REUSEPORT
+        if (::setsockopt(sd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0) {
+            tSystemError("setsockopt error  SO_REUSEPORT  errno:%d", errno);
+            goto socket_error;
+        }
+#else
+        tSystemWarn("SO_REUSEPORT not supported on this system");
+#endif
+    }
+
+    // Bind
+    if (address.protocol() == QAbstractSocket::IPv6Protocol) {
+        struct sockaddr_in6 sa6;
+        memset(&sa6, 0, sizeof(sa6));
+        sa6.sin6_family = AF_INET6;
+        sa6.sin6_port = htons(port);
+        Q_IPV6ADDR ip6 = address.toIPv6Address();
+        memcpy(&sa6.sin6_addr, &ip6, sizeof(ip6));
+        if (::bind(sd, (sockaddr *)&sa6, sizeof(sa6)) < 0) {
+            tSystemError("Bind failed  port:%d  errno:%d", port, errno);
+            goto socket_error;
+        }
+    } else {
+        struct sockaddr_in sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sin_family = AF_INET;
+        sa.sin_port = htons(port);
+        sa.sin_addr.s_addr = htonl(address.toIPv4Address());
+        if (::bind(sd, (sockaddr *)&sa, sizeof(sa)) < 0) {
+            tSystemError("Bind failed  port:%d  errno:%d", port, errno);
+            goto socket_error;
+        }
+    }
+    return sd;
+
+socket_error:
+    nativeClose(sd);
+    return 0;
+}
+
 /*!
   Listen a port for connections on a socket.
   This function must be called in a tfmanager process.
  */
 int TApplicationServer::nativeListen(const QHostAddress &address, quint16 port, OpenFlag flag)
 {
-    int sd = 0;
-    QTcpServer server;
+    const QSettings &settings = Tf::app()->appSettings();
+    int sd = nativeBind(address, port, flag);
+    if (sd <= 0) {
+        return 0;
+    }
 
-    if (!server.listen(address, port)) {
-        tSystemError("Listen failed  port:%d", port);
-        return sd;
+    // Waits for data before accepting
+    {
+        int secs = settings.value(DEFER_ACCEPT, 0).toInt();
+        if (secs > 0) {
+#ifdef TCP_DEFER_ACCEPT
+            if (::setsockopt(sd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &secs, sizeof(secs)) < 0) {
+                tSystemWarn("setsockopt error  TCP_DEFER_ACCEPT  errno:%d", errno);
+            }
+#else
+            tSystemWarn("TCP_DEFER_ACCEPT not supported on this system");
+#endif
+        }
     }
 
-    sd = ::fcntl(server.socketDescriptor(), F_DUPFD, 0); // duplicate
+    // TCP Fast Open
+    {
+        int qlen = settings.value(FAST_OPEN, 0).toInt();
+        if (qlen > 0) {
+#ifdef TCP_FASTOPEN
+            if (::setsockopt(sd, IPPROTO_TCP, TCP_FASTOPEN, &qlen, sizeof(qlen)) < 0) {
+                tSystemWarn("setsockopt error  TCP_FASTOPEN  errno:%d", errno);
+            }
+#else
+            tSystemWarn("TCP_FASTOPEN not supported on this system");
+#endif
+        }
+    }
 
-    if (flag == CloseOnExec) {
-        ::fcntl(sd, F_SETFD, ::fcntl(sd, F_GETFD) | FD_CLOEXEC);
-    } else {
-        ::fcntl(sd, F_SETFD, 0);  // clear
+    // Listen
+    if (::listen(sd, SOMAXCONN) < 0) {
+        tSystemError("Listen failed  port:%d  errno:%d", port, errno);
+        goto socket_error;
     }
-    ::fcntl(sd, F_SETFL, ::fcntl(sd, F_GETFL) | O_NONBLOCK);  // non-block
-    
-    server.close();    
     return sd;
+
+socket_error:
+    nativeClose(sd);
+    return 0;
 }
 
 /*!
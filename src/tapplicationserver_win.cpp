@@ -25,10 +25,10 @@ void TApplicationServer::nativeSocketCleanup()
 }
 
 /*!
-  Listen a port with SO_REUSEADDR option.
-  This function must be called in a tfserver process.
+  Binds a socket to the port with SO_REUSEADDR option without
+  listening on it.
  */
-int TApplicationServer::nativeListen(const QHostAddress &address, quint16 port, OpenFlag)
+int TApplicationServer::nativeBind(const QHostAddress &address, quint16 port, OpenFlag)
 {
     int protocol = (address.protocol() == QAbstractSocket::IPv6Protocol) ? AF_INET6 : AF_INET;
     SOCKET sock = ::WSASocket(protocol, SOCK_STREAM, 0, NULL, 0, WSA_FLAG_OVERLAPPED);
@@ -79,11 +79,6 @@ int TApplicationServer::nativeListen(const QHostAddress &address, quint16 port,
     } else {
         goto error_socket;
     }
-    
-    if (::listen(sock, 50) != 0) {
-        tSystemError("listen error: %d", WSAGetLastError());
-        goto error_socket;
-    }
     return sock;
 
 error_socket:
@@ -91,6 +86,24 @@ error_socket:
     return -1;
 }
 
+/*!
+  Listen a port with SO_REUSEADDR option.
+  This function must be called in a tfserver process.
+ */
+int TApplicationServer::nativeListen(const QHostAddress &address, quint16 port, OpenFlag flag)
+{
+    int sock = nativeBind(address, port, flag);
+    if (sock == (int)INVALID_SOCKET || sock < 0)
+        return -1;
+
+    if (::listen(sock, 50) != 0) {
+        tSystemError("listen error: %d", WSAGetLastError());
+        nativeClose(sock);
+        return -1;
+    }
+    return sock;
+}
+
 
 int TApplicationServer::nativeListen(const QString &, OpenFlag)
 {
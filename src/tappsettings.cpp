@@ -0,0 +1,43 @@
+/* Copyright (c) 2012, AOYAMA Kazuharu
+ * All rights reserved.
+ *
+ * This software may be used and distributed according to the terms of
+ * the New BSD License, which is incorporated herein by reference.
+ */
+
+#include <QSettings>
+#include <TAppSettings>
+
+/*!
+  \class TAppSettings
+  \brief The TAppSettings class holds the values of the application
+  settings used while handling requests. It is immutable once it is
+  created, so it can be read from any thread without locking.
+  \sa TWebApplication::settings()
+*/
+
+/*!
+  Constructor, which reads the values from \a settings.
+*/
+TAppSettings::TAppSettings(const QSettings &settings)
+    : listenPort(settings.value("ListenPort").toUInt()),
+      limitRequestBody(settings.value("LimitRequestBody", "0").toUInt()),
+      directViewRenderMode(settings.value("DirectViewRenderMode").toBool()),
+      enableCsrfProtectionModule(settings.value("EnableCsrfProtectionModule", true).toBool()),
+      htmlContentCharset(settings.value("HtmlContentCharset").toByteArray()),
+      sessionName(settings.value("Session.Name").toByteArray()),
+      sessionStoreType(settings.value("Session.StoreType").toString().toLower()),
+      sessionAutoIdRegeneration(settings.value("Session.AutoIdRegeneration").toBool()),
+      sessionLifeTime(settings.value("Session.LifeTime").toInt()),
+      sessionCookiePath(settings.value("Session.CookiePath").toString()),
+      sessionGcProbability(settings.value("Session.GcProbability").toInt()),
+      sessionGcMaxLifeTime(settings.value("Session.GcMaxLifeTime").toInt()),
+      sessionSecret(settings.value("Session.Secret").toByteArray()),
+      sessionCsrfProtectionKey(settings.value("Session.CsrfProtectionKey").toString()),
+      sqlQuerySlowThreshold(settings.value("SqlQuerySlowThreshold", 0).toInt()),
+      sqlResultCacheLifeTime(settings.value("SqlResultCache.LifeTime", 60).toInt()),
+      sqlResultCacheMaxEntries(settings.value("SqlResultCache.MaxEntries", 1000).toInt()),
+      metricsEnabled(settings.value("Metrics.Enable", false).toBool()),
+      metricsPath(settings.value("Metrics.Path", "/_metrics").toByteArray()),
+      metricsToken(settings.value("Metrics.Token").toByteArray().trimmed())
+{ }
@@ -0,0 +1,41 @@
+#ifndef TAPPSETTINGS_H
+#define TAPPSETTINGS_H
+
+#include <QString>
+#include <QByteArray>
+#include <TGlobal>
+
+class QSettings;
+
+
+class T_CORE_EXPORT TAppSettings
+{
+public:
+    TAppSettings(const QSettings &settings);
+
+    quint16 listenPort;
+    uint limitRequestBody;
+    bool directViewRenderMode;
+    bool enableCsrfProtectionModule;
+    QByteArray htmlContentCharset;
+    QByteArray sessionName;
+    QString sessionStoreType;
+    bool sessionAutoIdRegeneration;
+    int sessionLifeTime;
+    QString sessionCookiePath;
+    int sessionGcProbability;
+    int sessionGcMaxLifeTime;
+    QByteArray sessionSecret;
+    QString sessionCsrfProtectionKey;
+    int sqlQuerySlowThreshold;
+    int sqlResultCacheLifeTime;
+    int sqlResultCacheMaxEntries;
+    bool metricsEnabled;
+    QByteArray metricsPath;
+    QByteArray metricsToken;
+
+private:
+    Q_DISABLE_COPY(TAppSettings)
+};
+
+#endif // TAPPSETTINGS_H
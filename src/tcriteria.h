@@ -55,6 +55,7 @@ private:
     int logiOp;
 
     template<class T> friend class TCriteriaConverter;
+    friend class TCompiledCriteria;
 };
 
 Q_DECLARE_METATYPE(TCriteria)
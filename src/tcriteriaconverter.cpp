@@ -50,3 +50,310 @@ const QHash<int, QString> &TCriteriaData::formats()
     }
     return formatVector;
 } 
+
+
+/*!
+  \class TCompiledCriteria
+  \brief The TCompiledCriteria class represents a criteria compiled
+  into a SQL statement with '?' placeholders and its values.
+  The criteria is flattened into an expression tree in postfix order,
+  and the SQL statement is generated only once per the shape of it.
+  This class is for internal use only.
+  \sa TCriteriaConverter
+*/
+
+#define MAX_STATEMENT_CACHE  1000
+
+static QHash<QByteArray, QString> statementCache;
+static QMutex cacheMutex;
+
+
+static QString formatValue(const QVariant &val, const QSqlDatabase &database)
+{
+    switch (val.type()) {
+    case QVariant::Int:
+    case QVariant::UInt:
+    case QVariant::LongLong:
+    case QVariant::ULongLong:
+        if (!val.isNull()) {
+            return val.toString();
+        }
+        break;
+
+    default:
+        break;
+    }
+    return TSqlQuery::formatValue(val, database);
+}
+
+
+static QString propertyName(const QMetaObject *metaObject, int property)
+{
+    return QString::fromLatin1(metaObject->property(metaObject->propertyOffset() + property).name());
+}
+
+
+TCompiledCriteria::TCompiledCriteria(const TCriteria &criteria, const QMetaObject *metaObject, const QSqlDatabase &database)
+{
+    if (criteria.isEmpty() || !metaObject) {
+        return;
+    }
+
+    flatten(QVariant::fromValue(criteria), metaObject);
+
+    QByteArray key;
+    key.reserve(sizeof(metaObject) + 16 + nodes.count() * sizeof(Node));
+    key.append((const char *)&metaObject, sizeof(metaObject));
+    key.append(database.driverName().toLatin1()).append('\0');
+    key.append((const char *)nodes.constData(), nodes.count() * sizeof(Node));
+
+    QMutexLocker locker(&cacheMutex);
+    QHash<QByteArray, QString>::const_iterator it = statementCache.constFind(key);
+    if (it != statementCache.constEnd()) {
+        sql = it.value();
+        return;
+    }
+    locker.unlock();
+
+    sql = generate(nodes, metaObject, database);
+
+    locker.relock();
+    if (statementCache.count() >= MAX_STATEMENT_CACHE) {
+        statementCache.clear();
+    }
+    statementCache.insert(key, sql);
+}
+
+/*!
+  Returns the SQL string in which the placeholders are replaced
+  with the formatted values.
+*/
+QString TCompiledCriteria::toString(const QSqlDatabase &database) const
+{
+    if (values.isEmpty()) {
+        return sql;
+    }
+
+    QString string;
+    string.reserve(sql.length() + values.count() * 8);
+
+    int pos = 0;
+    QListIterator<QVariant> it(values);
+    while (it.hasNext()) {
+        int idx = sql.indexOf(QLatin1Char('?'), pos);
+        if (idx < 0) {
+            tSystemError("Logic error: [%s:%d]", __FILE__, __LINE__);
+            break;
+        }
+        string.append(sql.midRef(pos, idx - pos));
+        string.append(formatValue(it.next(), database));
+        pos = idx + 1;
+    }
+    string.append(sql.midRef(pos));
+    return string;
+}
+
+
+void TCompiledCriteria::appendNode(int kind, int property, int op1, int op2, int count)
+{
+    Node node;
+    node.kind = kind;
+    node.property = property;
+    node.op1 = op1;
+    node.op2 = op2;
+    node.count = count;
+    nodes.append(node);
+}
+
+
+void TCompiledCriteria::flatten(const QVariant &var, const QMetaObject *metaObject)
+{
+    if (var.isNull()) {
+        appendNode(Empty);
+        return;
+    }
+
+    // No copy of the criteria objects stored in the variants
+    if (var.userType() == qMetaTypeId<TCriteria>()) {
+        const TCriteria *cri = static_cast<const TCriteria *>(var.constData());
+        if (cri->isEmpty()) {
+            appendNode(Empty);
+            return;
+        }
+
+        flatten(cri->first(), metaObject);
+        switch (cri->logicalOperator()) {
+        case TCriteria::None:
+            break;
+
+        case TCriteria::And:
+            flatten(cri->second(), metaObject);
+            appendNode(And);
+            break;
+
+        case TCriteria::Or:
+            flatten(cri->second(), metaObject);
+            appendNode(Or);
+            break;
+
+        default:
+            tSystemError("Logic error: [%s:%d]", __FILE__, __LINE__);
+            break;
+        }
+
+    } else if (var.userType() == qMetaTypeId<TCriteriaData>()) {
+        flatten(*static_cast<const TCriteriaData *>(var.constData()), metaObject);
+
+    } else {
+        tSystemError("Logic error [%s:%d]", __FILE__, __LINE__);
+        appendNode(Empty);
+    }
+}
+
+
+void TCompiledCriteria::flatten(const TCriteriaData &cri, const QMetaObject *metaObject)
+{
+    if (cri.isEmpty() || cri.property >= metaObject->propertyCount() - metaObject->propertyOffset()) {
+        appendNode(Empty);
+        return;
+    }
+
+    if (cri.op2 != TSql::Invalid && !cri.val1.isNull()) {
+        if (cri.op2 != TSql::Any && cri.op2 != TSql::All) {
+            tWarn("Invalid parameters  [%s:%d]", __FILE__, __LINE__);
+            appendNode(Empty);
+            return;
+        }
+        QList<QVariant> list = cri.val1.toList();
+        values += list;
+        appendNode(Term, cri.property, cri.op1, cri.op2, list.count());
+        return;
+    }
+
+    switch (cri.op1) {
+    case TSql::Equal:
+    case TSql::NotEqual:
+    case TSql::LessThan:
+    case TSql::GreaterThan:
+    case TSql::LessEqual:
+    case TSql::GreaterEqual:
+    case TSql::Like:
+    case TSql::NotLike:
+    case TSql::ILike:
+    case TSql::NotILike:
+        if (!cri.val1.isNull() && !cri.val2.isNull()) {
+            tWarn("Invalid parameters  [%s:%d]", __FILE__, __LINE__);
+            appendNode(Empty);
+        } else {
+            values << cri.val1;
+            appendNode(Term, cri.property, cri.op1, TSql::Invalid, 1);
+        }
+        break;
+
+    case TSql::In:
+    case TSql::NotIn: {
+        QList<QVariant> list = cri.val1.toList();
+        if (list.isEmpty()) {
+            tWarn("error parameter");
+            appendNode(Empty);
+        } else {
+            values += list;
+            appendNode(Term, cri.property, cri.op1, TSql::Invalid, list.count());
+        }
+        break; }
+
+    case TSql::LikeEscape:
+    case TSql::NotLikeEscape:
+    case TSql::ILikeEscape:
+    case TSql::NotILikeEscape:
+    case TSql::Between:
+    case TSql::NotBetween:
+        if (!cri.val1.isNull() && !cri.val2.isNull()) {
+            values << cri.val1 << cri.val2;
+            appendNode(Term, cri.property, cri.op1, TSql::Invalid, 2);
+        } else {
+            QList<QVariant> list = cri.val1.toList();
+            if (list.count() == 2) {
+                values += list;
+                appendNode(Term, cri.property, cri.op1, TSql::Invalid, 2);
+            } else {
+                appendNode(Empty);
+            }
+        }
+        break;
+
+    case TSql::IsNull:
+    case TSql::IsNotNull:
+        appendNode(Term, cri.property, cri.op1, TSql::Invalid, 0);
+        break;
+
+    default:
+        tWarn("error parameter");
+        appendNode(Empty);
+        break;
+    }
+}
+
+/*!
+  Generates the SQL statement with placeholders from the expression
+  tree \a nodes.
+*/
+QString TCompiledCriteria::generate(const QVector<Node> &nodes, const QMetaObject *metaObject, const QSqlDatabase &database)
+{
+    QStringList stack;
+
+    for (QVectorIterator<Node> it(nodes); it.hasNext(); ) {
+        const Node &node = it.next();
+
+        switch (node.kind) {
+        case Empty:
+            stack << QString();
+            break;
+
+        case Term: {
+            QString name = TSqlQuery::escapeIdentifier(propertyName(metaObject, node.property), QSqlDriver::FieldName, database);
+            QString placeholders;
+            placeholders.reserve(node.count * 2);
+            for (int i = 0; i < node.count; ++i) {
+                placeholders.append(QLatin1String("?,"));
+            }
+            placeholders.chop(1);
+
+            if (node.op2 != TSql::Invalid) {
+                QString str = TCriteriaData::formats().value(node.op2).arg(placeholders);
+                stack << name + TCriteriaData::formats().value(node.op1).arg(str);
+            } else if (node.count == 2 && node.op1 != TSql::In && node.op1 != TSql::NotIn) {
+                stack << QLatin1String("(") + name + TCriteriaData::formats().value(node.op1).arg(QLatin1String("?"), QLatin1String("?")) + QLatin1String(")");
+            } else if (node.count == 0) {
+                stack << name + TCriteriaData::formats().value(node.op1);
+            } else {
+                stack << name + TCriteriaData::formats().value(node.op1).arg(placeholders);
+            }
+            break; }
+
+        case And:
+        case Or: {
+            if (stack.count() < 2) {
+                tSystemError("Logic error: [%s:%d]", __FILE__, __LINE__);
+                return QString();
+            }
+            QString s2 = stack.takeLast();
+            QString &s1 = stack.last();
+            if (s1.isEmpty()) {
+                s1 = s2;
+            } else if (!s2.isEmpty()) {
+                if (node.kind == And) {
+                    s1 = s1 + QLatin1String(" AND ") + s2;
+                } else {
+                    s1 = QLatin1String("( ") + s1 + QLatin1String(" OR ") + s2 + QLatin1String(" )");
+                }
+            }
+            break; }
+
+        default:
+            tSystemError("Logic error: [%s:%d]", __FILE__, __LINE__);
+            break;
+        }
+    }
+    return stack.value(0);
+}
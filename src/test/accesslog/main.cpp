@@ -0,0 +1,92 @@
+#include <QTest>
+#include <QDateTime>
+#include "taccesslog.h"
+
+
+class TestAccessLog : public QObject
+{
+    Q_OBJECT
+private slots:
+    void layout_data();
+    void layout();
+    void timestamp();
+    void json();
+};
+
+
+static TAccessLog accessLog()
+{
+    TAccessLog log("192.168.0.10", "GET /blog/entry/index HTTP/1.1");
+    log.timestamp = QDateTime(QDate(2012, 4, 1), QTime(12, 34, 56));
+    log.statusCode = 200;
+    log.responseBytes = 12345;
+    log.beganTransactions = 1;
+    log.committedTransactions = 1;
+    log.totalTime = 9000;
+    log.readTime = 100;
+    log.routingTime = 20;
+    log.sessionTime = 300;
+    log.controllerTime = 8000;
+    log.renderTime = 2500;
+    log.sqlQueryTime = 4000;
+    log.sqlQueryCount = 3;
+    log.writeTime = 500;
+    return log;
+}
+
+
+void TestAccessLog::layout_data()
+{
+    QTest::addColumn<QByteArray>("layout");
+    QTest::addColumn<QByteArray>("result");
+
+    QTest::newRow("common") << QByteArray("%h \"%r\" %s %O%n")
+                            << QByteArray("192.168.0.10 \"GET /blog/entry/index HTTP/1.1\" 200 12345\n");
+    QTest::newRow("transactions") << QByteArray("%x") << QByteArray("1/1/0");
+    QTest::newRow("total") << QByteArray("%D") << QByteArray("9000");
+    QTest::newRow("phases") << QByteArray("read:%I routing:%U session:%S controller:%C write:%W")
+                            << QByteArray("read:100 routing:20 session:300 controller:8000 write:500");
+    QTest::newRow("render") << QByteArray("%V") << QByteArray("2500");
+    QTest::newRow("sql") << QByteArray("%Q/%q") << QByteArray("4000/3");
+    QTest::newRow("width") << QByteArray("%5D") << QByteArray("9000");
+    QTest::newRow("unknown") << QByteArray("%z %D") << QByteArray("%z 9000");
+    QTest::newRow("percent") << QByteArray("100%% %D") << QByteArray("100% 9000");
+    QTest::newRow("trailing") << QByteArray("%D %") << QByteArray("9000 %");
+}
+
+
+void TestAccessLog::layout()
+{
+    QFETCH(QByteArray, layout);
+    QFETCH(QByteArray, result);
+
+    TAccessLog log = accessLog();
+    QCOMPARE(log.toByteArray(layout, QByteArray()), result);
+    QCOMPARE(log.toByteArray(TAccessLogLayout(layout, QByteArray())), result);
+}
+
+
+void TestAccessLog::timestamp()
+{
+    TAccessLog log = accessLog();
+    TAccessLogLayout layout("[%d] %D", "yyyy-MM-dd hh:mm:ss");
+    QCOMPARE(log.toByteArray(layout), QByteArray("[2012-04-01 12:34:56] 9000"));
+
+    // Formatted again in the next second
+    log.timestamp = log.timestamp.addSecs(1);
+    QCOMPARE(log.toByteArray(layout), QByteArray("[2012-04-01 12:34:57] 9000"));
+}
+
+
+void TestAccessLog::json()
+{
+    TAccessLog log = accessLog();
+    TAccessLogLayout layout(QByteArray(), "yyyy-MM-dd\"hh\\mm", TAccessLogLayout::JsonLines);
+    QByteArray json = log.toByteArray(layout);
+    QVERIFY(json.startsWith("{\"time\":\"2012-04-01\\\"12\\\\34\",\"host\":\"192.168.0.10\","));
+    QVERIFY(json.endsWith("}\n"));
+}
+
+
+QTEST_APPLESS_MAIN(TestAccessLog)
+#include "main.moc"
@@ -0,0 +1,274 @@
+#include <TfTest/TfTest>
+#include <QSqlDatabase>
+#include <THttpRequestHeader>
+#include <THttpRequest>
+#include <THttpUtility>
+#include <TMultipartFormData>
+#include <THtmlParser>
+#include <TCriteria>
+#include <TCriteriaConverter>
+#include <TLogger>
+#include <TLog>
+#include "taccesslog.h"
+
+/*
+  Micro-benchmarks of the primitives used in every request.
+  Run compare.sh to compare the results with the baseline.
+*/
+
+class BenchModel : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(int id READ id)
+    Q_PROPERTY(QString name READ name)
+    Q_PROPERTY(int price READ price)
+    Q_PROPERTY(QString created_at READ createdAt)
+public:
+    enum PropertyIndex {
+        Id = 0,
+        Name,
+        Price,
+        CreatedAt,
+    };
+
+    int id() const { return 0; }
+    QString name() const { return QString(); }
+    int price() const { return 0; }
+    QString createdAt() const { return QString(); }
+};
+
+
+class BenchMark : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void parseRequestHeader();
+    void parseBody();
+    void fromUrlEncoding();
+    void htmlEscape();
+    void jsonEscape();
+    void parseMultipartFormData();
+    void parseHtml();
+    void criteriaToString();
+    void logToByteArray();
+    void logLayoutFormat();
+    void accessLogToByteArray();
+    void accessLogLayoutFormat();
+
+private:
+    QSqlDatabase database;
+};
+
+
+static const char requestHeader[] =
+    "POST /blog/entry/create?page=2&sort=desc HTTP/1.1\r\n"
+    "Host: www.example.com\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:12.0) Gecko/20100101 Firefox/12.0\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+    "Accept-Language: ja,en-us;q=0.7,en;q=0.3\r\n"
+    "Accept-Encoding: gzip, deflate\r\n"
+    "Connection: keep-alive\r\n"
+    "Referer: http://www.example.com/blog/entry/index\r\n"
+    "Cookie: TFSESSION=d41d8cd98f00b204e9800998ecf8427e0123456789abcdef; lang=ja\r\n"
+    "Content-Type: application/x-www-form-urlencoded\r\n"
+    "\r\n";
+
+static const char htmlText[] =
+    "<!DOCTYPE html>\n<html>\n<head>\n<meta charset=\"UTF-8\">\n<title>Blog</title>\n"
+    "<link href=\"/css/style.css\" rel=\"stylesheet\" type=\"text/css\">\n</head>\n<body>\n"
+    "<h1>Listing Entries</h1>\n<table border=\"1\" cellpadding=\"5\">\n"
+    "<tr><th>ID</th><th>Title</th><th>Body</th><th></th></tr>\n";
+
+
+static QByteArray formBody()
+{
+    QByteArray body;
+    for (int i = 0; i < 20; ++i) {
+        if (i > 0)
+            body += '&';
+        body += "entry%5Bfield" + QByteArray::number(i) + "%5D=value+%E3%81%82+" + QByteArray::number(i) + "%26%3D";
+    }
+    return body;
+}
+
+
+static QString escapeText()
+{
+    QString text;
+    for (int i = 0; i < 20; ++i) {
+        text += QString::fromUtf8("Text <b>\"bold\"</b> & 'quoted' \xe3\x81\x82\xe3\x81\x84 \\path\n");
+    }
+    return text;
+}
+
+
+void BenchMark::initTestCase()
+{
+    database = QSqlDatabase::addDatabase("QSQLITE", "benchmark");
+    database.setDatabaseName(":memory:");
+    QVERIFY(database.open());
+}
+
+
+void BenchMark::cleanupTestCase()
+{
+    database.close();
+    database = QSqlDatabase();
+    QSqlDatabase::removeDatabase("benchmark");
+}
+
+
+void BenchMark::parseRequestHeader()
+{
+    QByteArray header(requestHeader);
+    QBENCHMARK {
+        THttpRequestHeader hdr(header);
+        hdr.contentLength();
+    }
+}
+
+
+void BenchMark::parseBody()
+{
+    QByteArray header(requestHeader);
+    QByteArray body = formBody();
+    QBENCHMARK {
+        THttpRequest req(header, body);
+        req.allParameters();
+    }
+}
+
+
+void BenchMark::fromUrlEncoding()
+{
+    QByteArray encoded = formBody();
+    QBENCHMARK {
+        THttpUtility::fromUrlEncoding(encoded);
+    }
+}
+
+
+void BenchMark::htmlEscape()
+{
+    QString text = escapeText();
+    QBENCHMARK {
+        THttpUtility::htmlEscape(text);
+    }
+}
+
+
+void BenchMark::jsonEscape()
+{
+    QString text = escapeText();
+    QBENCHMARK {
+        THttpUtility::jsonEscape(text);
+    }
+}
+
+
+void BenchMark::parseMultipartFormData()
+{
+    QByteArray boundary("---------------------------168072824752491622650073");
+    QByteArray data;
+    for (int i = 0; i < 3; ++i) {
+        data += "--" + boundary + "\r\nContent-Disposition: form-data; name=\"field" + QByteArray::number(i) + "\"\r\n\r\n";
+        data += "value " + QByteArray::number(i) + "\r\n";
+    }
+    data += "--" + boundary + "\r\nContent-Disposition: form-data; name=\"file\"; filename=\"data.bin\"\r\n";
+    data += "Content-Type: application/octet-stream\r\n\r\n";
+    data += QByteArray(10240, 'x') + "\r\n";
+    data += "--" + boundary + "--\r\n";
+
+    QBENCHMARK {
+        TMultipartFormData formData(data, "--" + boundary);
+        formData.formItemValue("field0");
+    }
+}
+
+
+void BenchMark::parseHtml()
+{
+    QString html(htmlText);
+    for (int i = 0; i < 20; ++i) {
+        html += QString("<tr><td>%1</td><td>Title %1</td><td>Body &amp; text</td>"
+                        "<td><a href=\"/blog/entry/show/%1\">Show</a></td></tr>\n").arg(i);
+    }
+    html += "</table>\n</body>\n</html>\n";
+
+    QBENCHMARK {
+        THtmlParser parser;
+        parser.parse(html);
+    }
+}
+
+
+void BenchMark::criteriaToString()
+{
+    QBENCHMARK {
+        TCriteria cri(BenchModel::Id, TSql::GreaterThan, 10);
+        cri.add(BenchModel::Name, TSql::Like, "%treefrog%");
+        cri.add(BenchModel::Price, TSql::Between, 100, 2000);
+        cri.add(BenchModel::Id, TSql::In, QVariantList() << 1 << 2 << 3 << 4 << 5);
+        cri.add(TCriteria(BenchModel::CreatedAt, TSql::IsNull) || TCriteria(BenchModel::Price, 0));
+        TCriteriaConverter<BenchModel>(cri, database).toString();
+    }
+}
+
+
+void BenchMark::logToByteArray()
+{
+    TLog log(TLogger::Info, "Processed request in 12 msec; controller:blog action:show");
+    QByteArray layout("%d %5P [%t] %m%n");
+    QByteArray format("yyyy-MM-ddThh:mm:ss");
+
+    QBENCHMARK {
+        TLogger::logToByteArray(log, layout, format);
+    }
+}
+
+
+void BenchMark::logLayoutFormat()
+{
+    TLog log(TLogger::Info, "Processed request in 12 msec; controller:blog action:show");
+    TLogLayout layout("%d %5P [%t] %m%n", "yyyy-MM-ddThh:mm:ss");
+
+    QBENCHMARK {
+        TLogger::logToByteArray(log, layout);
+    }
+}
+
+
+void BenchMark::accessLogToByteArray()
+{
+    TAccessLog log("192.168.0.10", "GET /blog/entry/index HTTP/1.1");
+    log.timestamp = QDateTime::currentDateTime();
+    log.statusCode = 200;
+    log.responseBytes = 12345;
+    log.totalTime = 3456;
+    QByteArray layout("%h %d \"%r\" %s %O %D%n");
+    QByteArray format("yyyy-MM-dd hh:mm:ss");
+
+    QBENCHMARK {
+        log.toByteArray(layout, format);
+    }
+}
+
+
+void BenchMark::accessLogLayoutFormat()
+{
+    TAccessLog log("192.168.0.10", "GET /blog/entry/index HTTP/1.1");
+    log.statusCode = 200;
+    log.responseBytes = 12345;
+    log.totalTime = 3456;
+    TAccessLogLayout layout("%h %d \"%r\" %s %O %D%n", "yyyy-MM-dd hh:mm:ss");
+
+    QBENCHMARK {
+        log.toByteArray(layout);
+    }
+}
+
+
+TF_TEST_SQLLESS_MAIN(BenchMark)
+#include "benchmarking.moc"
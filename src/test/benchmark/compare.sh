@@ -0,0 +1,93 @@
+#!/bin/sh
+#
+# Runs the micro-benchmarks and compares the results with the baseline.
+#
+# Usage: compare.sh [-t PERCENT] [save|compare] [RESULT_FILE]
+#
+#   save     Runs the benchmarks and saves the results as the baseline.
+#   compare  Runs the benchmarks and compares the results with the
+#            baseline (default). Exits with 1 if any benchmark is slower
+#            than the baseline by more than PERCENT (default: 10).
+#
+# If RESULT_FILE is given, the results are read from the file, which is
+# the output of the benchmark program, instead of running it.
+#
+
+cd `dirname $0`
+
+BASELINE=baseline.txt
+THRESHOLD=10
+BENCHMARK=./benchmark
+[ -x ./benchmarkd ] && BENCHMARK=./benchmarkd
+
+if [ "$1" = "-t" ]; then
+  THRESHOLD=$2
+  shift 2
+fi
+MODE=${1:-compare}
+RESULT=$2
+
+# Prints "name value unit" for each result of the QTest output
+extract()
+{
+  awk '/^RESULT : / { name = $3; sub(/\(\):$/, "", name); getline; print name, $1, $2 }' "$1"
+}
+
+run()
+{
+  if [ -n "$RESULT" ]; then
+    extract "$RESULT"
+  else
+    TMP=`mktemp`
+    $BENCHMARK > $TMP 2>&1
+    if [ $? -ne 0 ]; then
+      cat $TMP >&2
+      rm -f $TMP
+      echo "Benchmark failed" >&2
+      exit 2
+    fi
+    extract $TMP
+    rm -f $TMP
+  fi
+}
+
+case "$MODE" in
+  save)
+    run > $BASELINE
+    cat $BASELINE
+    echo "Saved the baseline: $BASELINE"
+    ;;
+  compare)
+    if [ ! -f $BASELINE ]; then
+      echo "No baseline. Run '$0 save' first." >&2
+      exit 2
+    fi
+    run | awk -v threshold=$THRESHOLD -v baseline=$BASELINE '
+      BEGIN {
+        while ((getline line < baseline) > 0) {
+          split(line, f, " ")
+          base[f[1]] = f[2]
+        }
+        printf "%-40s %14s %14s %9s\n", "Benchmark", "Baseline", "Current", "Change"
+        failed = 0
+      }
+      {
+        if (!($1 in base) || base[$1] <= 0) {
+          printf "%-40s %14s %14s %9s\n", $1, "-", $2 " " $3, "new"
+          next
+        }
+        change = ($2 - base[$1]) * 100.0 / base[$1]
+        mark = ""
+        if (change > threshold) {
+          mark = "  << slower"
+          failed = 1
+        }
+        printf "%-40s %14s %14s %+8.1f%%%s\n", $1, base[$1], $2 " " $3, change, mark
+      }
+      END { exit failed }'
+    ;;
+  *)
+    sed -n '3,14p' $0 | sed 's/^# \{0,1\}//'
+    exit 2
+    ;;
+esac
@@ -0,0 +1,120 @@
+#include <QTest>
+#include <QSqlDatabase>
+#include <TCriteria>
+#include <TCriteriaConverter>
+
+
+class Item : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(int id READ id)
+    Q_PROPERTY(QString name READ name)
+    Q_PROPERTY(int price READ price)
+    Q_PROPERTY(QString created_at READ createdAt)
+public:
+    enum PropertyIndex {
+        Id = 0,
+        Name,
+        Price,
+        CreatedAt,
+    };
+
+    int id() const { return 0; }
+    QString name() const { return QString(); }
+    int price() const { return 0; }
+    QString createdAt() const { return QString(); }
+};
+
+class TestCriteriaConverter : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void toString_data();
+    void toString();
+    void compile();
+
+private:
+    QSqlDatabase database;
+};
+
+
+void TestCriteriaConverter::initTestCase()
+{
+    database = QSqlDatabase::addDatabase("QSQLITE", "criteriaconverter");
+    database.setDatabaseName(":memory:");
+    QVERIFY(database.open());
+}
+
+
+void TestCriteriaConverter::cleanupTestCase()
+{
+    database.close();
+    database = QSqlDatabase();
+    QSqlDatabase::removeDatabase("criteriaconverter");
+}
+
+
+void TestCriteriaConverter::toString_data()
+{
+    QTest::addColumn<TCriteria>("criteria");
+    QTest::addColumn<QString>("sql");
+
+    QTest::newRow("empty") << TCriteria() << QString();
+    QTest::newRow("equal") << TCriteria(Item::Id, 10) << QString("\"id\"=10");
+    QTest::newRow("string") << TCriteria(Item::Name, QString("it's")) << QString("\"name\"='it''s'");
+    QTest::newRow("and") << TCriteria(Item::Id, TSql::GreaterThan, 10).add(Item::Name, TSql::Like, QString("%frog%"))
+                         << QString("\"id\">10 AND \"name\" LIKE '%frog%'");
+    QTest::newRow("or") << (TCriteria(Item::Id, 1) || TCriteria(Item::Id, 2))
+                        << QString("( \"id\"=1 OR \"id\"=2 )");
+    QTest::newRow("or-and") << ((TCriteria(Item::Id, 1) || TCriteria(Item::Price, TSql::LessThan, 100)) && TCriteria(Item::Name, TSql::IsNotNull))
+                            << QString("( \"id\"=1 OR \"price\"<100 ) AND \"name\" IS NOT NULL");
+    QTest::newRow("and-or") << (TCriteria(Item::Id, 1).add(Item::Price, 100) || TCriteria(Item::Name, TSql::IsNull))
+                            << QString("( \"id\"=1 AND \"price\"=100 OR \"name\" IS NULL )");
+    QTest::newRow("placeholder in value") << TCriteria(Item::Name, QString("what?")).add(Item::Id, 1)
+                                          << QString("\"name\"='what?' AND \"id\"=1");
+    QTest::newRow("in") << TCriteria(Item::Id, TSql::In, QVariantList() << 1 << 2 << 3)
+                        << QString("\"id\" IN (1,2,3)");
+    QTest::newRow("in two") << TCriteria(Item::Id, TSql::In, QVariantList() << 1 << 2)
+                            << QString("\"id\" IN (1,2)");
+    QTest::newRow("notin") << TCriteria(Item::Name, TSql::NotIn, QVariantList() << QString("a") << QString("b'c"))
+                           << QString("\"name\" NOT IN ('a','b''c')");
+    QTest::newRow("between") << TCriteria(Item::Price, TSql::Between, 100, 2000)
+                             << QString("(\"price\" BETWEEN 100 AND 2000)");
+    QTest::newRow("notbetween list") << TCriteria(Item::Price, TSql::NotBetween, QVariantList() << 1 << 5)
+                                     << QString("(\"price\" NOT BETWEEN 1 AND 5)");
+    QTest::newRow("likeescape") << TCriteria(Item::Name, TSql::LikeEscape, QString("a!%%"), QString("!"))
+                                << QString("(\"name\" LIKE 'a!%%' ESCAPE '!')");
+    QTest::newRow("isnull") << TCriteria(Item::CreatedAt, TSql::IsNull) << QString("\"created_at\" IS NULL");
+    QTest::newRow("any") << TCriteria(Item::Price, TSql::GreaterEqual, TSql::Any, QVariantList() << 10 << 20 << 50)
+                         << QString("\"price\">=ANY (10,20,50)");
+    QTest::newRow("all") << TCriteria(Item::Price, TSql::LessThan, TSql::All, QVariantList() << 1 << 2)
+                         << QString("\"price\"<ALL (1,2)");
+}
+
+
+void TestCriteriaConverter::toString()
+{
+    QFETCH(TCriteria, criteria);
+    QFETCH(QString, sql);
+
+    QCOMPARE(TCriteriaConverter<Item>(criteria, database).toString(), sql);
+    // Generated from the statement cache
+    QCOMPARE(TCriteriaConverter<Item>(criteria, database).toString(), sql);
+}
+
+
+void TestCriteriaConverter::compile()
+{
+    TCriteria cri(Item::Id, TSql::GreaterThan, 10);
+    cri.add(Item::Name, TSql::In, QVariantList() << QString("a") << QString("b"));
+
+    TCompiledCriteria compiled = TCriteriaConverter<Item>(cri, database).compile();
+    QCOMPARE(compiled.statement(), QString("\"id\">? AND \"name\" IN (?,?)"));
+    QCOMPARE(compiled.boundValues(), QVariantList() << 10 << QString("a") << QString("b"));
+}
+
+
+QTEST_MAIN(TestCriteriaConverter)
+#include "main.moc"
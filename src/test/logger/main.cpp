@@ -0,0 +1,87 @@
+#include <QTest>
+#include <QDateTime>
+#include <QTextCodec>
+#include <TLogger>
+#include <TLog>
+
+
+class TestLogger : public QObject
+{
+    Q_OBJECT
+private slots:
+    void layout_data();
+    void layout();
+    void timestamp();
+    void codec();
+};
+
+
+static TLog testLog(const QByteArray &message = "hello")
+{
+    TLog log(TLogger::Info, message);
+    log.timestamp = QDateTime(QDate(2012, 4, 1), QTime(12, 34, 56));
+    log.pid = 1234;
+    log.threadId = 255;
+    return log;
+}
+
+
+void TestLogger::layout_data()
+{
+    QTest::addColumn<QByteArray>("layout");
+    QTest::addColumn<QByteArray>("result");
+
+    QTest::newRow("message") << QByteArray("%m%n") << QByteArray("hello\n");
+    QTest::newRow("priority") << QByteArray("[%p] [%P]") << QByteArray("[info] [INFO]");
+    QTest::newRow("priority width") << QByteArray("[%8P]") << QByteArray("[INFO    ]");
+    QTest::newRow("thread") << QByteArray("%t %T") << QByteArray("255 ff");
+    QTest::newRow("thread zero") << QByteArray("%05t %04T") << QByteArray("00255 00ff");
+    QTest::newRow("pid width") << QByteArray("[%6i] [%I]") << QByteArray("[  1234] [4d2]");
+    QTest::newRow("percent") << QByteArray("100%% %m") << QByteArray("100% hello");
+    QTest::newRow("unknown") << QByteArray("%x %m") << QByteArray("%x hello");
+    QTest::newRow("trailing") << QByteArray("%m %") << QByteArray("hello %");
+    QTest::newRow("trailing width") << QByteArray("%m %5") << QByteArray("hello %5");
+}
+
+
+void TestLogger::layout()
+{
+    QFETCH(QByteArray, layout);
+    QFETCH(QByteArray, result);
+
+    QCOMPARE(TLogger::logToByteArray(testLog(), layout, QByteArray()), result);
+    QCOMPARE(TLogger::logToByteArray(testLog(), TLogLayout(layout, QByteArray())), result);
+}
+
+
+void TestLogger::timestamp()
+{
+    TLog l = testLog();
+    TLogLayout layout("[%d] %m", "yyyy-MM-dd hh:mm:ss");
+    QCOMPARE(TLogger::logToByteArray(l, layout), QByteArray("[2012-04-01 12:34:56] hello"));
+
+    // Formatted again in the next second
+    l.timestamp = l.timestamp.addSecs(1);
+    QCOMPARE(TLogger::logToByteArray(l, layout), QByteArray("[2012-04-01 12:34:57] hello"));
+
+    // Another format in the same second
+    TLogLayout other("%d", "hh:mm:ss");
+    QCOMPARE(TLogger::logToByteArray(l, other), QByteArray("12:34:57"));
+    QCOMPARE(TLogger::logToByteArray(l, layout), QByteArray("[2012-04-01 12:34:57] hello"));
+}
+
+
+void TestLogger::codec()
+{
+    QTextCodec::setCodecForLocale(QTextCodec::codecForName("UTF-8"));
+    TLog l = testLog("caf\xc3\xa9");
+    TLogLayout layout("%P %m", QByteArray());
+
+    QCOMPARE(TLogger::logToByteArray(l, layout), QByteArray("INFO caf\xc3\xa9"));
+    QCOMPARE(TLogger::logToByteArray(l, layout, QTextCodec::codecForLocale()), QByteArray("INFO caf\xc3\xa9"));
+    QCOMPARE(TLogger::logToByteArray(l, layout, QTextCodec::codecForName("ISO-8859-1")), QByteArray("INFO caf\xe9"));
+}
+
+
+QTEST_APPLESS_MAIN(TestLogger)
+#include "main.moc"
@@ -0,0 +1,184 @@
+#include <QtCore>
+#include <TActionController>
+#include <TActionView>
+#include <TSqlObject>
+#include <TSqlORMapper>
+#include <THttpUtility>
+
+/*
+  Model, controller and views of the fixture application, written as
+  the code generated by the generator and tmake.
+*/
+
+class ItemObject : public TSqlObject
+{
+public:
+    int id;
+    QString name;
+    int price;
+
+    enum PropertyIndex {
+        Id = 0,
+        Name,
+        Price,
+    };
+
+    QString tableName() const { return "item"; }
+    int primaryKeyIndex() const { return Id; }
+
+private:    /*** Don't modify below this line ***/
+    Q_OBJECT
+    Q_PROPERTY(int id READ getid WRITE setid)
+    T_DEFINE_PROPERTY(int, id)
+    Q_PROPERTY(QString name READ getname WRITE setname)
+    T_DEFINE_PROPERTY(QString, name)
+    Q_PROPERTY(int price READ getprice WRITE setprice)
+    T_DEFINE_PROPERTY(int, price)
+};
+
+
+class BenchController : public TActionController
+{
+    Q_OBJECT
+public:
+    BenchController() : TActionController() { }
+    BenchController(const BenchController &) : TActionController() { }
+
+public slots:
+    void text();
+    void page();
+    void items();
+};
+
+T_DECLARE_CONTROLLER(BenchController, benchcontroller)
+
+
+void BenchController::text()
+{
+    renderText("Hello world");
+}
+
+
+void BenchController::page()
+{
+    QString title = "Server Benchmark <TreeFrog>";
+    QStringList lines;
+    for (int i = 0; i < 20; ++i) {
+        lines << QString("Line %1: \"quoted\" & <escaped>").arg(i);
+    }
+    T_EXPORT(title);
+    T_EXPORT(lines);
+    render();
+}
+
+
+void BenchController::items()
+{
+    TSqlORMapper<ItemObject> mapper;
+    mapper.setSort(ItemObject::Id, TSql::AscendingOrder);
+    mapper.setLimit(50);
+    mapper.find();
+
+    QList<QVariant> items;
+    for (int i = 0; i < mapper.rowCount(); ++i) {
+        ItemObject item = mapper.value(i);
+        items << (QStringList() << QString::number(item.id) << item.name << QString::number(item.price));
+    }
+    T_EXPORT(items);
+    render();
+}
+
+T_REGISTER_CONTROLLER(benchcontroller)
+
+
+class bench_pageView : public TActionView
+{
+    Q_OBJECT
+public:
+    bench_pageView() : TActionView() { }
+    bench_pageView(const bench_pageView &) : TActionView() { }
+    QString toString();
+};
+
+
+QString bench_pageView::toString()
+{
+    responsebody.reserve(2048);
+    T_FETCH(QString, title);
+    T_FETCH(QStringList, lines);
+
+    responsebody += QLatin1String("<h1>");
+    responsebody += THttpUtility::htmlEscape(title);
+    responsebody += QLatin1String("</h1>\n<ul>\n");
+    for (QStringListIterator it(lines); it.hasNext(); ) {
+        responsebody += QLatin1String("  <li>");
+        responsebody += THttpUtility::htmlEscape(it.next());
+        responsebody += QLatin1String("</li>\n");
+    }
+    responsebody += QLatin1String("</ul>\n");
+    return responsebody;
+}
+
+Q_DECLARE_METATYPE(bench_pageView)
+T_REGISTER_VIEW(bench_pageView)
+
+
+class bench_itemsView : public TActionView
+{
+    Q_OBJECT
+public:
+    bench_itemsView() : TActionView() { }
+    bench_itemsView(const bench_itemsView &) : TActionView() { }
+    QString toString();
+};
+
+
+QString bench_itemsView::toString()
+{
+    responsebody.reserve(4096);
+    T_FETCH(QList<QVariant>, items);
+
+    responsebody += QLatin1String("<table>\n<tr><th>ID</th><th>Name</th><th>Price</th></tr>\n");
+    for (QListIterator<QVariant> it(items); it.hasNext(); ) {
+        QStringList item = it.next().toStringList();
+        responsebody += QLatin1String("<tr><td>");
+        responsebody += THttpUtility::htmlEscape(item.value(0));
+        responsebody += QLatin1String("</td><td>");
+        responsebody += THttpUtility::htmlEscape(item.value(1));
+        responsebody += QLatin1String("</td><td>");
+        responsebody += THttpUtility::htmlEscape(item.value(2));
+        responsebody += QLatin1String("</td></tr>\n");
+    }
+    responsebody += QLatin1String("</table>\n");
+    return responsebody;
+}
+
+Q_DECLARE_METATYPE(bench_itemsView)
+T_REGISTER_VIEW(bench_itemsView)
+
+
+class layouts_benchView : public TActionView
+{
+    Q_OBJECT
+public:
+    layouts_benchView() : TActionView() { }
+    layouts_benchView(const layouts_benchView &) : TActionView() { }
+    QString toString();
+};
+
+
+QString layouts_benchView::toString()
+{
+    responsebody.reserve(1024);
+    responsebody += QLatin1String("<!DOCTYPE html>\n<html>\n<head>\n  <meta charset=\"UTF-8\">\n  <title>");
+    responsebody += THttpUtility::htmlEscape(controller()->name() + ": " + controller()->activeAction());
+    responsebody += QLatin1String("</title>\n</head>\n<body>\n");
+    responsebody += yield();
+    responsebody += QLatin1String("</body>\n</html>\n");
+    return responsebody;
+}
+
+Q_DECLARE_METATYPE(layouts_benchView)
+T_REGISTER_VIEW(layouts_benchView)
+
+#include "benchcontroller.moc"
@@ -0,0 +1,118 @@
+#include <QTcpSocket>
+#include <QHostAddress>
+#include <QCoreApplication>
+#include <TGlobal>
+#include "tsystemglobal.h"
+#include "loadgenerator.h"
+
+
+double LoadResult::requestsPerSecond() const
+{
+    return (elapsed > 0) ? requests * 1000000.0 / elapsed : 0.0;
+}
+
+/*
+  Returns the \a p percentile of the latencies, which must be sorted.
+*/
+qint64 LoadResult::percentile(double p) const
+{
+    if (latencies.isEmpty())
+        return 0;
+
+    int idx = qMin((int)(p * latencies.count()), latencies.count() - 1);
+    return latencies[idx];
+}
+
+
+LoadThread::LoadThread(quint16 p, const QByteArray &pth, qint64 end)
+    : QThread(), port(p), path(pth), endTime(end), errorCount(0)
+{
+    times.reserve(100000);
+}
+
+/*
+  Sends a GET request for the \a path and reads the response until the
+  server closes the connection. Returns true if the status is 200.
+*/
+bool LoadThread::request(quint16 port, const QByteArray &path)
+{
+    QTcpSocket socket;
+    socket.connectToHost(QHostAddress::LocalHost, port);
+    if (!socket.waitForConnected(5000))
+        return false;
+
+    socket.write("GET " + path + " HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+    QByteArray response;
+    while (socket.waitForReadyRead(5000)) {
+        response += socket.readAll();
+    }
+    response += socket.readAll();
+    return response.mid(9, 3) == "200";
+}
+
+
+void LoadThread::run()
+{
+    while (tMicroseconds() < endTime) {
+        qint64 start = tMicroseconds();
+        if (request(port, path)) {
+            times << tMicroseconds() - start;
+        } else {
+            ++errorCount;
+        }
+    }
+}
+
+
+LoadGenerator::LoadGenerator(quint16 p, int c)
+    : port(p), concurrency(c)
+{ }
+
+/*
+  Sends requests for the \a path from the concurrent threads for
+  \a seconds. Events of the main thread are processed meanwhile.
+*/
+LoadResult LoadGenerator::run(const QByteArray &path, int seconds)
+{
+    qint64 start = tMicroseconds();
+    qint64 end = start + seconds * Q_INT64_C(1000000);
+
+    QList<LoadThread *> threads;
+    for (int i = 0; i < concurrency; ++i) {
+        LoadThread *thread = new LoadThread(port, path, end);
+        thread->start();
+        threads << thread;
+    }
+
+    LoadResult result;
+    for (QListIterator<LoadThread *> it(threads); it.hasNext(); ) {
+        LoadThread *thread = it.next();
+        while (!thread->wait(10)) {
+            qApp->processEvents();
+        }
+        result.latencies += thread->latencies();
+        result.errors += thread->errors();
+        delete thread;
+    }
+    result.elapsed = tMicroseconds() - start;
+    result.requests = result.latencies.count();
+    qSort(result.latencies);
+    return result;
+}
+
+/*
+  Waits for \a seconds at most until the server responds to the
+  request for the \a path.
+*/
+bool LoadGenerator::waitForServer(const QByteArray &path, int seconds)
+{
+    qint64 end = tMicroseconds() + seconds * Q_INT64_C(1000000);
+    while (tMicroseconds() < end) {
+        if (LoadThread::request(port, path))
+            return true;
+
+        qApp->processEvents();
+        Tf::msleep(100);
+    }
+    return false;
+}
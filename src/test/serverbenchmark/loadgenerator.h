@@ -0,0 +1,54 @@
+#ifndef LOADGENERATOR_H
+#define LOADGENERATOR_H
+
+#include <QThread>
+#include <QVector>
+#include <QByteArray>
+
+
+struct LoadResult
+{
+    int requests;
+    int errors;
+    qint64 elapsed;  // in microseconds
+    QVector<qint64> latencies;
+
+    LoadResult() : requests(0), errors(0), elapsed(0) { }
+    double requestsPerSecond() const;
+    qint64 percentile(double p) const;
+};
+
+
+class LoadGenerator
+{
+public:
+    LoadGenerator(quint16 port, int concurrency);
+    LoadResult run(const QByteArray &path, int seconds);
+    bool waitForServer(const QByteArray &path, int seconds);
+
+private:
+    quint16 port;
+    int concurrency;
+};
+
+
+class LoadThread : public QThread
+{
+public:
+    LoadThread(quint16 port, const QByteArray &path, qint64 endTime);
+    const QVector<qint64> &latencies() const { return times; }
+    int errors() const { return errorCount; }
+    static bool request(quint16 port, const QByteArray &path);
+
+protected:
+    void run();
+
+private:
+    quint16 port;
+    QByteArray path;
+    qint64 endTime;
+    QVector<qint64> times;
+    int errorCount;
+};
+
+#endif // LOADGENERATOR_H
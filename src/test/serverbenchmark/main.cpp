@@ -0,0 +1,362 @@
+#include <QtCore>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QHostAddress>
+#include <TWebApplication>
+#include <TApplicationServer>
+#include "tsystemglobal.h"
+#include "loadgenerator.h"
+#include <stdio.h>
+#include <signal.h>
+
+/*
+  Server-level benchmark
+
+  Starts application servers against a fixture application in a
+  temporary directory and sends requests of each scenario from the
+  concurrent clients over the loopback, for each MPM. The directory is
+  removed on exit.
+
+  It takes a while and listens on a port, so it's not built with the
+  other tests; run qmake and make in this directory to build it.
+
+  Usage: serverbenchmark [-c CONCURRENCY] [-d SECONDS] [-m thread|prefork] [-p PORT]
+*/
+
+#define SERVER_OPTION  "--server"
+
+struct Scenario
+{
+    const char *name;
+    const char *path;
+};
+
+static const Scenario scenarios[] = {
+    { "static", "/hello.txt" },
+    { "text",   "/bench/text" },
+    { "view",   "/bench/page" },
+    { "model",  "/bench/items" },
+    { 0, 0 },
+};
+
+
+static bool writeFile(const QString &path, const QByteArray &data)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    return file.write(data) == data.length();
+}
+
+
+static bool removeDirectory(const QString &path)
+{
+    QDir dir(path);
+    QFileInfoList list = dir.entryInfoList(QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot);
+    for (QListIterator<QFileInfo> it(list); it.hasNext(); ) {
+        const QFileInfo &fi = it.next();
+        if (fi.isDir() && !fi.isSymLink()) {
+            removeDirectory(fi.absoluteFilePath());
+        } else {
+            dir.remove(fi.fileName());
+        }
+    }
+    return dir.rmdir(dir.absolutePath());
+}
+
+/*
+  Removes the fixture directory when the benchmark exits.
+*/
+class FixtureRemover
+{
+public:
+    FixtureRemover(const QString &path) : webRoot(path) { }
+    ~FixtureRemover()
+    {
+        if (!removeDirectory(webRoot)) {
+            fprintf(stderr, "Failed to remove the fixture: %s\n", qPrintable(webRoot));
+        }
+    }
+
+private:
+    QString webRoot;
+};
+
+
+static bool createFixture(const QString &webRoot)
+{
+    QDir dir(webRoot);
+    dir.mkpath("config");
+    dir.mkpath("public");
+    dir.mkpath("log");
+    dir.mkpath("lib");
+    dir.mkpath("db");
+
+    bool ok = writeFile(dir.filePath("config/database.ini"),
+                        "[product]\ndriverType=QSQLITE\nDatabaseName=db/bench.db\n");
+    ok &= writeFile(dir.filePath("config/logger.ini"), "[General]\nLoggers=\n");
+    ok &= writeFile(dir.filePath("config/routes.cfg"), "");
+    ok &= writeFile(dir.filePath("public/hello.txt"), "Hello world\n");
+    if (!ok)
+        return false;
+
+    // SQLite database
+    QFile::remove(dir.filePath("db/bench.db"));
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "fixture");
+        db.setDatabaseName(dir.filePath("db/bench.db"));
+        if (!db.open())
+            return false;
+
+        QSqlQuery query(db);
+        query.exec("CREATE TABLE item (id INTEGER PRIMARY KEY, name VARCHAR(64), price INTEGER)");
+        db.transaction();
+        query.prepare("INSERT INTO item (id, name, price) VALUES (?, ?, ?)");
+        for (int i = 1; i <= 100; ++i) {
+            query.addBindValue(i);
+            query.addBindValue(QString("Item <%1> & \"name\"").arg(i));
+            query.addBindValue(i * 100);
+            query.exec();
+        }
+        db.commit();
+        db.close();
+    }
+    QSqlDatabase::removeDatabase("fixture");
+    return true;
+}
+
+
+static bool writeAppSettings(const QString &webRoot, const QString &mpm, quint16 port, int concurrency)
+{
+    QByteArray ini;
+    ini += "ListenPort=" + QByteArray::number(port) + "\n";
+    ini += "InternalEncoding=UTF-8\n";
+    ini += "HttpOutputEncoding=UTF-8\n";
+    ini += "MultiProcessingModule=" + mpm.toLatin1() + "\n";
+    ini += "MPM.thread.MaxServers=" + QByteArray::number(qMax(concurrency * 2, 20)) + "\n";
+    ini += "MPM.prefork.MaxServers=" + QByteArray::number(concurrency) + "\n";
+    ini += "SqlQueryLogFile=\n";
+    ini += "AccessLog.FilePath=log/access.log\n";
+    ini += "HtmlContentCharset=UTF-8\n";
+    ini += "Session.Name=TFSESSION\n";
+    ini += "Session.StoreType=cookie\n";
+    ini += "Session.LifeTime=0\n";
+    ini += "Session.CookiePath=/\n";
+    ini += "Session.GcProbability=0\n";
+    ini += "Session.GcInterval=0\n";
+    ini += "Session.Secret=zV8HeSQfdD5sMgvbr2qTkPFwYnx3pR6Ju\n";
+    ini += "Session.CsrfProtectionKey=_csrfId\n";
+    return writeFile(QDir(webRoot).filePath("config/application.ini"), ini);
+}
+
+/*
+  Server process, started by the benchmark with the listening socket.
+*/
+static int runServer(int argc, char *argv[])
+{
+    TWebApplication webapp(argc, argv);
+    tSetupSystemLoggers();
+    tSetupLoggers();
+
+#if defined(Q_OS_UNIX)
+    webapp.watchUnixSignal(SIGTERM);
+    webapp.ignoreUnixSignal(SIGINT);
+#endif
+
+    QStringList args = webapp.arguments();
+    int sd = args.value(args.indexOf("-s") + 1).toInt();
+    TApplicationServer *server = new TApplicationServer(&webapp);
+    if (sd <= 0 || !server->setSocketDescriptor(sd) || !server->open()) {
+        fprintf(stderr, "Server open failed\n");
+        return 1;
+    }
+    return webapp.exec();
+}
+
+/*
+  Keeps the number of the server processes, restarting the prefork
+  servers which exit after each request.
+*/
+class ServerLauncher : public QObject
+{
+    Q_OBJECT
+public:
+    ServerLauncher(const QString &webRoot, int socket, int count);
+    ~ServerLauncher() { stop(); }
+    void start();
+    void stop();
+
+protected slots:
+    void startServer();
+    void serverFinished();
+
+private:
+    QString webRoot;
+    int socket;
+    int count;
+    bool running;
+    QList<QProcess *> processes;
+};
+
+
+ServerLauncher::ServerLauncher(const QString &root, int sd, int cnt)
+    : QObject(), webRoot(root), socket(sd), count(cnt), running(false)
+{ }
+
+
+void ServerLauncher::start()
+{
+    running = true;
+    for (int i = 0; i < count; ++i) {
+        startServer();
+    }
+}
+
+
+void ServerLauncher::stop()
+{
+    running = false;
+    for (QListIterator<QProcess *> it(processes); it.hasNext(); ) {
+        QProcess *process = it.next();
+        process->disconnect(this);
+        process->terminate();
+        if (!process->waitForFinished(5000)) {
+            process->kill();
+            process->waitForFinished();
+        }
+        delete process;
+    }
+    processes.clear();
+}
+
+
+void ServerLauncher::startServer()
+{
+    QProcess *process = new QProcess;
+    connect(process, SIGNAL(finished(int, QProcess::ExitStatus)), this, SLOT(serverFinished()));
+    processes << process;
+    process->start(QCoreApplication::applicationFilePath(),
+                   QStringList() << SERVER_OPTION << webRoot << "-s" << QString::number(socket));
+}
+
+
+void ServerLauncher::serverFinished()
+{
+    QProcess *process = qobject_cast<QProcess *>(sender());
+    if (process) {
+        processes.removeAll(process);
+        process->deleteLater();
+    }
+
+    if (running) {
+        startServer();
+    }
+}
+
+
+static void printHeader()
+{
+    printf("%-8s %-8s %9s %10s %9s %9s %9s %9s %9s %7s\n", "MPM", "Scenario", "Requests",
+           "Req/s", "Mean(ms)", "p50(ms)", "p90(ms)", "p99(ms)", "Max(ms)", "Errors");
+}
+
+
+static void printResult(const QString &mpm, const char *scenario, const LoadResult &res)
+{
+    qint64 total = 0;
+    for (int i = 0; i < res.latencies.count(); ++i) {
+        total += res.latencies[i];
+    }
+    double mean = (res.requests > 0) ? total / 1000.0 / res.requests : 0.0;
+
+    printf("%-8s %-8s %9d %10.1f %9.3f %9.3f %9.3f %9.3f %9.3f %7d\n", qPrintable(mpm), scenario,
+           res.requests, res.requestsPerSecond(), mean, res.percentile(0.5) / 1000.0,
+           res.percentile(0.9) / 1000.0, res.percentile(0.99) / 1000.0,
+           (res.latencies.isEmpty() ? 0.0 : res.latencies.last() / 1000.0), res.errors);
+    fflush(stdout);
+}
+
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && !strcmp(argv[1], SERVER_OPTION)) {
+        return runServer(argc, argv);
+    }
+
+    int concurrency = 8;
+    int seconds = 3;
+    quint16 port = 18800;
+    QStringList mpms;
+    for (int i = 1; i < argc; ++i) {
+        QByteArray opt = argv[i];
+        QByteArray val = (i + 1 < argc) ? argv[++i] : "";
+        if (opt == "-c") {
+            concurrency = qMax(val.toInt(), 1);
+        } else if (opt == "-d") {
+            seconds = qMax(val.toInt(), 1);
+        } else if (opt == "-m") {
+            mpms << val;
+        } else if (opt == "-p") {
+            port = val.toUShort();
+        } else {
+            fprintf(stderr, "usage: %s [-c CONCURRENCY] [-d SECONDS] [-m thread|prefork] [-p PORT]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (mpms.isEmpty()) {
+        mpms << "thread";
+#if defined(Q_OS_UNIX)
+        mpms << "prefork";
+#endif
+    }
+
+    QString webRoot = QDir::tempPath() + QString("/tfbenchmark%1/").arg(QCoreApplication::applicationPid());
+    FixtureRemover remover(webRoot);  // removed after the application
+    if (!createFixture(webRoot) || !writeAppSettings(webRoot, mpms.first(), port, concurrency)) {
+        fprintf(stderr, "Failed to create the fixture: %s\n", qPrintable(webRoot));
+        return 1;
+    }
+
+    QByteArray root = webRoot.toLocal8Bit();
+    int appArgc = 2;
+    char *appArgv[] = { argv[0], root.data(), 0 };
+    TWebApplication app(appArgc, appArgv);
+
+    int sd = TApplicationServer::nativeListen(QHostAddress::LocalHost, port, TApplicationServer::NonCloseOnExec);
+    if (sd <= 0) {
+        fprintf(stderr, "Failed to listen the port: %d\n", port);
+        return 1;
+    }
+
+    printf("Concurrency: %d  Duration: %d sec/scenario  Fixture: %s\n\n", concurrency, seconds, qPrintable(webRoot));
+    printHeader();
+
+    int errors = 0;
+    for (QStringListIterator it(mpms); it.hasNext(); ) {
+        const QString &mpm = it.next();
+        writeAppSettings(webRoot, mpm, port, concurrency);
+
+        ServerLauncher launcher(webRoot, sd, (mpm == "prefork") ? concurrency : 1);
+        launcher.start();
+
+        LoadGenerator generator(port, concurrency);
+        if (!generator.waitForServer(scenarios[0].path, 10)) {
+            fprintf(stderr, "Server not responding: %s\n", qPrintable(mpm));
+            ++errors;
+            continue;
+        }
+
+        for (int i = 0; scenarios[i].name; ++i) {
+            LoadResult res = generator.run(scenarios[i].path, seconds);
+            printResult(mpm, scenarios[i].name, res);
+            errors += res.errors + ((res.requests == 0) ? 1 : 0);
+        }
+        launcher.stop();
+    }
+
+    TApplicationServer::nativeClose(sd);
+    return (errors > 0) ? 1 : 0;
+}
+
+#include "main.moc"
@@ -0,0 +1,25 @@
+TARGET = serverbenchmark
+TEMPLATE = app
+CONFIG += console debug
+CONFIG -= app_bundle
+QT += network sql
+QT -= gui
+DEFINES += TF_DLL
+INCLUDEPATH += ../../../include ../..
+HEADERS = loadgenerator.h
+SOURCES = main.cpp loadgenerator.cpp benchcontroller.cpp
+
+
+include(../../../tfbase.pri)
+win32 {
+  CONFIG(debug, debug|release) {
+    TARGET = $$join(TARGET,,,d)
+    LIBS += -L "..\\..\\debug" -ltreefrogd$${TF_VER_MAJ}
+  } else {
+    LIBS += -L "..\\..\\release" -ltreefrog$${TF_VER_MAJ}
+  }
+} else:macx {
+  LIBS += -F../../ -framework treefrog
+} else:unix {
+  LIBS += -L../../ -ltreefrog
+}
@@ -0,0 +1,99 @@
+#include <QTest>
+#include <QDataStream>
+#include <QDateTime>
+#include <QStringList>
+#include <tsessionstore.h>
+
+
+class TestSessionCodec : public QObject
+{
+    Q_OBJECT
+private slots:
+    void roundTrip_data();
+    void roundTrip();
+    void compression();
+    void olderFormat();
+    void broken();
+};
+
+
+void TestSessionCodec::roundTrip_data()
+{
+    QTest::addColumn<QVariant>("value");
+
+    QTest::newRow("null") << QVariant();
+    QTest::newRow("true") << QVariant(true);
+    QTest::newRow("false") << QVariant(false);
+    QTest::newRow("int") << QVariant(-123456);
+    QTest::newRow("uint") << QVariant(4000000000U);
+    QTest::newRow("longlong") << QVariant(Q_INT64_C(-9223372036854775807));
+    QTest::newRow("ulonglong") << QVariant(Q_UINT64_C(18446744073709551615));
+    QTest::newRow("double") << QVariant(3.14159);
+    QTest::newRow("string") << QVariant(QString::fromUtf8("\xe3\x81\x82\xe3\x81\x84 abc"));
+    QTest::newRow("bytearray") << QVariant(QByteArray("\x00\x01\xff", 3));
+    QTest::newRow("stringlist") << QVariant(QStringList() << "foo" << "" << "bar");
+    QTest::newRow("datetime") << QVariant(QDateTime(QDate(2012, 4, 1), QTime(12, 34, 56)));
+}
+
+
+void TestSessionCodec::roundTrip()
+{
+    QFETCH(QVariant, value);
+
+    TSession session("abc");
+    session.insert("key", value);
+    session.insert(QString::fromUtf8("\xe3\x82\xad\xe3\x83\xbc"), 1);
+
+    TSession result;
+    QVERIFY(TSessionStore::deserialize(TSessionStore::serialize(session), result));
+    QCOMPARE(result.count(), 2);
+    QCOMPARE(result.value("key").type(), value.type());
+    QCOMPARE(result.value("key"), value);
+    QCOMPARE(result.value(QString::fromUtf8("\xe3\x82\xad\xe3\x83\xbc")).toInt(), 1);
+}
+
+
+void TestSessionCodec::compression()
+{
+    TSession session;
+    session.insert("text", QString(1000, QLatin1Char('a')));
+    QByteArray data = TSessionStore::serialize(session);
+    QVERIFY(data.length() < 1000);
+
+    TSession result;
+    QVERIFY(TSessionStore::deserialize(data, result));
+    QCOMPARE(result.value("text").toString(), QString(1000, QLatin1Char('a')));
+}
+
+
+void TestSessionCodec::olderFormat()
+{
+    QVariantHash hash;
+    hash.insert("foo", 1);
+    hash.insert("bar", "hoge");
+
+    QByteArray data;
+    QDataStream ds(&data, QIODevice::WriteOnly);
+    ds << hash;
+
+    TSession result;
+    QVERIFY(TSessionStore::deserialize(data, result));
+    QCOMPARE(result.value("foo").toInt(), 1);
+    QCOMPARE(result.value("bar").toString(), QString("hoge"));
+}
+
+
+void TestSessionCodec::broken()
+{
+    TSession session;
+    session.insert("foo", QString("bar"));
+    QByteArray data = TSessionStore::serialize(session);
+    data.chop(2);
+
+    TSession result;
+    QVERIFY(!TSessionStore::deserialize(data, result));
+}
+
+
+QTEST_APPLESS_MAIN(TestSessionCodec)
+#include "main.moc"
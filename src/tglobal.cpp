@@ -6,6 +6,9 @@
  */
 
 #include <QStringList>
+#include <QThread>
+#include <QThreadStorage>
+#include <QAtomicInt>
 #include <TGlobal>
 #include <TWebApplication>
 #include <TLogger>
@@ -172,28 +175,100 @@ quint32 Tf::random(quint32 max)
 /*
   Xorshift random number generator implement
 */
-static QMutex randMutex;
-static quint32 x = 123456789;
-static quint32 y = 362436169;
-static quint32 z = 1943734098;
-static quint32 w = 1;
+class TXor128State
+{
+public:
+    TXor128State() : generation(-1) { }
+    void seed(quint32 seed);
+    quint32 next()
+    {
+        quint32 t = x ^ (x << 11);
+        x = y;
+        y = z;
+        z = w;
+        w = w ^ (w >> 19) ^ (t ^ (t >> 8));
+        return w;
+    }
 
+    int generation;
+    quint32 x, y, z, w;
+};
 
-void Tf::srandXor128(quint32 seed)
+static QThreadStorage<TXor128State *> randStates;
+static QAtomicInt randSeed(1);
+static QAtomicInt randGeneration;
+static QAtomicInt randThreadCount;
+
+
+static inline quint32 mix32(quint32 h)
 {
-    QMutexLocker lock(&randMutex);
-    w = seed;
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
 }
 
 
+void TXor128State::seed(quint32 seed)
+{
+    // The first thread starts with the initial values of the
+    // generator; the others are shifted by the thread ID
+    int num = randThreadCount.fetchAndAddRelaxed(1);
+    quint32 id = (num == 0) ? 0 : mix32((quint32)(quintptr)QThread::currentThreadId() ^ ((quint32)num << 16));
+    x = 123456789 ^ id;
+    y = 362436169 ^ mix32(id);
+    z = 1943734098 ^ mix32(id + 1);
+    w = seed ^ mix32(id + 2);
+    if (!(x | y | z | w))
+        w = 1;
+}
+
+
+static inline TXor128State *randState()
+{
+    TXor128State *state = randStates.localData();
+    if (!state) {
+        state = new TXor128State();
+        randStates.setLocalData(state);
+    }
+
+    int gen = randGeneration;
+    if (state->generation != gen) {
+        state->seed((quint32)(int)randSeed);
+        state->generation = gen;
+    }
+    return state;
+}
+
+/*!
+  Sets the seed of the random number generator. Each thread has its
+  own generator, derived from \a seed and the thread ID.
+*/
+void Tf::srandXor128(quint32 seed)
+{
+    randSeed.fetchAndStoreOrdered((int)seed);
+    randGeneration.fetchAndAddOrdered(1);
+}
+
+/*!
+  Returns a random number of the Xorshift generator of the current
+  thread.
+*/
 quint32 Tf::randXor128()
 {
-    QMutexLocker lock(&randMutex);
-    quint32 t;
-    t = x ^ (x << 11);
-    x = y;
-    y = z;
-    z = w;
-    w = w ^ (w >> 19) ^ (t ^ (t >> 8));
-    return w;
+    return randState()->next();
+}
+
+/*!
+  Fills \a data with \a count random numbers of the Xorshift generator
+  of the current thread.
+*/
+void Tf::randXor128(quint32 *data, int count)
+{
+    TXor128State *state = randState();
+    for (int i = 0; i < count; ++i) {
+        data[i] = state->next();
+    }
 }
@@ -140,6 +140,7 @@ namespace Tf
     // Xorshift random number generator
     T_CORE_EXPORT void srandXor128(quint32 seed);
     T_CORE_EXPORT quint32 randXor128();
+    T_CORE_EXPORT void randXor128(quint32 *data, int count);
     T_CORE_EXPORT quint32 random(quint32 max);
 }
 
@@ -10,6 +10,7 @@
 #include <QBuffer>
 #include <TTemporaryFile>
 #include <TWebApplication>
+#include <TAppSettings>
 #include <THttpResponse>
 #include <THttpHeader>
 #include <TMultipartFormData>
@@ -134,7 +135,7 @@ bool THttpSocket::canReadRequest() const
 void THttpSocket::readRequest()
 {
     T_TRACEFUNC();
-    uint limitBodyBytes = Tf::app()->appSettings().value("LimitRequestBody", "0").toUInt();
+    uint limitBodyBytes = Tf::app()->settings().limitRequestBody;
     qint64 bytes = 0;
     QByteArray buf;
 
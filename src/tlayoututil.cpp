@@ -0,0 +1,64 @@
+/* Copyright (c) 2012, AOYAMA Kazuharu
+ * All rights reserved.
+ *
+ * This software may be used and distributed according to the terms of
+ * the New BSD License, which is incorporated herein by reference.
+ */
+
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include "tlayoututil.h"
+
+/*
+  Timestamps formatted last in the process per format, valid in the
+  same second. They are shared by all the threads, since a thread of
+  the thread MPM logs only one request.
+*/
+struct TimestampEntry
+{
+    qint64 second;
+    QByteArray text;
+};
+
+static QHash<QByteArray, TimestampEntry> timestampCache;
+static QMutex timestampMutex;
+
+/*!
+  Appends the \a timestamp formatted with the \a format, or in ISO 8601
+  if it's empty, to the \a message. Unless the format contains
+  milliseconds, the text is formatted once a second.
+*/
+void tAppendTimestamp(QByteArray &message, const QDateTime &timestamp, const QByteArray &format)
+{
+    bool cacheable = !format.contains('z');
+    qint64 second = 0;
+
+    if (cacheable) {
+        // Seconds since the epoch of the julian day, not converted to UTC
+        QTime time = timestamp.time();
+        second = timestamp.date().toJulianDay() * Q_INT64_C(86400) + time.hour() * 3600 + time.minute() * 60 + time.second();
+
+        QMutexLocker locker(&timestampMutex);
+        QHash<QByteArray, TimestampEntry>::const_iterator it = timestampCache.constFind(format);
+        if (it != timestampCache.constEnd() && it.value().second == second) {
+            message.append(it.value().text);
+            return;
+        }
+    }
+
+    QByteArray text;
+    if (!format.isEmpty()) {
+        text = timestamp.toString(format).toLocal8Bit();
+    } else {
+        text = timestamp.toString(Qt::ISODate).toLatin1();
+    }
+
+    if (cacheable) {
+        QMutexLocker locker(&timestampMutex);
+        TimestampEntry &entry = timestampCache[format];
+        entry.second = second;
+        entry.text = text;
+    }
+    message.append(text);
+}
@@ -0,0 +1,73 @@
+#ifndef TLAYOUTUTIL_H
+#define TLAYOUTUTIL_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QVector>
+#include <TGlobal>
+
+/*
+  Helpers of the layouts of the log and the access log, internal use.
+*/
+
+T_CORE_EXPORT void tAppendTimestamp(QByteArray &message, const QDateTime &timestamp, const QByteArray &format);
+
+/*
+  Parses the \a layout into the \a elements. A conversion character in
+  \a conversions makes an element, of which the width and the fill
+  character are taken from the digits after '%'; the other characters
+  make literal elements. '%n' is a newline and '%%' is a '%'.
+*/
+template <class Element>
+inline void tParseLayout(const QByteArray &layout, const char *conversions, QVector<Element> &elements)
+{
+    QByteArray text;
+    int pos = 0;
+    while (pos < layout.length()) {
+        char c = layout.at(pos++);
+        if (c != '%') {
+            text.append(c);
+            continue;
+        }
+
+        QByteArray dig;
+        for (;;) {
+            if (pos >= layout.length()) {
+                text.append('%').append(dig);
+                break;
+            }
+
+            c = layout.at(pos++);
+            if (c >= '0' && c <= '9') {
+                dig += c;
+                continue;
+            }
+
+            if (c && strchr(conversions, c)) {
+                if (!text.isEmpty()) {
+                    Element lit = { 0, 0, ' ', text };
+                    elements << lit;
+                    text.clear();
+                }
+                char fillChar = (dig.length() > 0 && dig[0] == '0') ? '0' : ' ';
+                Element conv = { c, dig.toInt(), fillChar, QByteArray() };
+                elements << conv;
+
+            } else if (c == 'n') {  // %n : newline
+                text.append('\n');
+            } else if (c == '%') {  // %% : percent sign
+                text.append('%');
+            } else {
+                text.append('%').append(dig).append(c);
+            }
+            break;
+        }
+    }
+
+    if (!text.isEmpty()) {
+        Element lit = { 0, 0, ' ', text };
+        elements << lit;
+    }
+}
+
+#endif // TLAYOUTUTIL_H
@@ -11,6 +11,7 @@
 #include <TLogger>
 #include <TWebApplication>
 #include <TSystemGlobal>
+#include "tlayoututil.h"
 
 #define DEFAULT_TEXT_ENCODING "DefaultTextEncoding"
 
@@ -44,79 +45,26 @@ QVariant TLogger::settingsValue(const QString &k, const QVariant &defaultValue)
 
 QByteArray TLogger::logToByteArray(const TLog &log) const
 {
-    return logToByteArray(log, layout(), dateTimeFormat(), codec_);
+    return compiledLayout_.format(log, codec_);
 }
 
-
+/*!
+  Returns the \a log formatted with the \a layout and
+  \a dateTimeFormat, encoded by the \a codec. The layout is parsed on
+  each call.
+*/
 QByteArray TLogger::logToByteArray(const TLog &log, const QByteArray &layout, const QByteArray &dateTimeFormat, QTextCodec *codec)
 {
-    QByteArray message;
-    message.reserve(layout.length() + log.message.length() + 100);
-    
-    int pos = 0;
-    while (pos < layout.length()) {
-        char c = layout.at(pos++);
-        if (c != '%') {
-            message.append(c);
-            continue;
-        }
-        
-        QByteArray dig;
-        for (;;) {
-            if (pos >= layout.length()) {
-                message.append('%').append(dig);
-                break;
-            }
-            
-            c = layout.at(pos++);
-            if (c >= '0' && c <= '9') {
-                dig += c;
-                continue;
-            }
-            
-            if (c == 'd') {  // %d : timestamp
-                if (!dateTimeFormat.isEmpty()) {
-                    message.append(log.timestamp.toString(dateTimeFormat).toLatin1());
-                } else {
-                    message.append(log.timestamp.toString(Qt::ISODate).toLatin1());
-                }
-            } else if (c == 'p' || c == 'P') {  // %p or %P : priority
-                QByteArray pri = priorityToString((TLogger::Priority)log.priority);
-                if (c == 'p') {
-                    pri = pri.toLower();
-                }
-                if (!pri.isEmpty()) {
-                    message.append(pri);
-                    int d = dig.toInt() - pri.length();
-                    if (d > 0) {
-                        message.append(QByteArray(d, ' '));
-                    }
-                }
-                
-            } else if (c == 't' || c == 'T') {  // %t or %T : thread ID (dec or hex)
-                QChar fillChar = (dig.length() > 0 && dig[0] == '0') ? QLatin1Char('0') : QLatin1Char(' ');
-                message.append(QString("%1").arg((qulonglong)log.threadId, dig.toInt(), ((c == 't') ? 10 : 16), fillChar).toLatin1());
-                
-            } else if (c == 'i' || c == 'I') {  // %i or %I : PID (dec or hex)
-                QChar fillChar = (dig.length() > 0 && dig[0] == '0') ? QLatin1Char('0') : QLatin1Char(' ');
-                message.append(QString("%1").arg(log.pid, dig.toInt(), ((c == 'i') ? 10 : 16), fillChar).toLatin1());
-                
-            } else if (c == 'n') {  // %n : newline
-                message.append('\n');
-            } else if (c == 'm') {  // %m : message
-                message.append(log.message);
-            } else if (c == '%') {
-                message.append('%').append(dig);
-                dig.clear();
-                continue;
-            } else {
-                message.append('%').append(dig).append(c);
-            }
-            break;
-        }
-    }
+    return TLogLayout(layout, dateTimeFormat).format(log, codec);
+}
 
-    return (codec) ? codec->fromUnicode(QString::fromLocal8Bit(message.data(), message.length())) : message;
+/*!
+  Returns the \a log formatted with the compiled \a layout, encoded by
+  the \a codec.
+*/
+QByteArray TLogger::logToByteArray(const TLog &log, const TLogLayout &layout, QTextCodec *codec)
+{
+    return layout.format(log, codec);
 }
 
 
@@ -134,9 +82,7 @@ void TLogger::readSettings()
     if (!codecName.isEmpty()) {
         QTextCodec *c = QTextCodec::codecForName(codecName);
         if (c) {
-            if (c->name() != QTextCodec::codecForLocale()->name()) {
-                codec_ = c;
-            }
+            codec_ = c;  // not used while it's the locale codec
             //tSystemDebug("set log text codec: %s", c->name().data());
         } else {
             tSystemError("log text codec matching the name could be not found: %s", codecName.data());
@@ -145,6 +91,7 @@ void TLogger::readSettings()
 
     layout_ = settingsValue("Layout", "%m%n").toByteArray();
     dateTimeFormat_ = settingsValue("DateTimeFormat").toByteArray();
+    compiledLayout_ = TLogLayout(layout_, dateTimeFormat_);
     
     QByteArray pri = settingsValue("Threshold", "trace").toByteArray().toUpper().trimmed();
     threshold_ = priorityHash()->key(pri, TLogger::Trace);
@@ -158,3 +105,93 @@ void TLogger::readSettings()
         dir.mkpath(".");
     }
 }
+
+
+/*!
+  \class TLogLayout
+  \brief The TLogLayout class is a layout of the log compiled into the
+  formatting elements, which is parsed once when the settings are read.
+*/
+
+TLogLayout::TLogLayout()
+    : reserveSize(0)
+{ }
+
+
+TLogLayout::TLogLayout(const QByteArray &layout, const QByteArray &format)
+    : dateTimeFormat(format), reserveSize(layout.length() + 100)
+{
+    tParseLayout(layout, "dpPtTiIm", elements);
+}
+
+/*
+  Appends the number right-aligned in the width.
+*/
+static inline void appendNumber(QByteArray &message, const QByteArray &num, int width, char fillChar)
+{
+    int d = width - num.length();
+    if (d > 0) {
+        message.append(QByteArray(d, fillChar));
+    }
+    message.append(num);
+}
+
+/*!
+  Returns the \a log formatted with this layout. If the \a codec is
+  not the locale codec, the result is encoded by it.
+*/
+QByteArray TLogLayout::format(const TLog &log, QTextCodec *codec) const
+{
+    QByteArray message;
+    message.reserve(reserveSize + log.message.length());
+
+    for (QVectorIterator<Element> it(elements); it.hasNext(); ) {
+        const Element &e = it.next();
+        switch (e.conversion) {
+        case 0:
+            message.append(e.text);
+            break;
+
+        case 'd':  // %d : timestamp
+            tAppendTimestamp(message, log.timestamp, dateTimeFormat);
+            break;
+
+        case 'p':  // %p or %P : priority
+        case 'P': {
+            QByteArray pri = TLogger::priorityToString((TLogger::Priority)log.priority);
+            if (e.conversion == 'p') {
+                pri = pri.toLower();
+            }
+            if (!pri.isEmpty()) {
+                message.append(pri);
+                int d = e.width - pri.length();
+                if (d > 0) {
+                    message.append(QByteArray(d, ' '));
+                }
+            }
+            break; }
+
+        case 't':  // %t or %T : thread ID (dec or hex)
+        case 'T':
+            appendNumber(message, QByteArray::number(log.threadId, ((e.conversion == 't') ? 10 : 16)), e.width, e.fillChar);
+            break;
+
+        case 'i':  // %i or %I : PID (dec or hex)
+        case 'I':
+            appendNumber(message, QByteArray::number(log.pid, ((e.conversion == 'i') ? 10 : 16)), e.width, e.fillChar);
+            break;
+
+        case 'm':  // %m : message
+            message.append(log.message);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    if (codec && codec != QTextCodec::codecForLocale()) {
+        return codec->fromUnicode(QString::fromLocal8Bit(message.data(), message.length()));
+    }
+    return message;
+}
@@ -3,12 +3,36 @@
 
 #include <QString>
 #include <QVariant>
+#include <QVector>
 #include <TGlobal>
 #include <TLog>
 
 class QTextCodec;
 
 
+class T_CORE_EXPORT TLogLayout
+{
+public:
+    TLogLayout();
+    TLogLayout(const QByteArray &layout, const QByteArray &dateTimeFormat);
+    QByteArray format(const TLog &log, QTextCodec *codec = 0) const;
+
+private:
+    struct Element
+    {
+        char conversion;  // 0 for the literal text
+        int width;
+        char fillChar;
+        QByteArray text;
+    };
+
+    QVector<Element> elements;
+    QByteArray dateTimeFormat;
+    int reserveSize;
+};
+
+
+
 class T_CORE_EXPORT TLogger
 {
 public:
@@ -40,11 +64,13 @@ public:
     QVariant settingsValue(const QString &key, const QVariant &defaultValue = QVariant()) const;
 
     static QByteArray logToByteArray(const TLog &log, const QByteArray &layout, const QByteArray &dateTimeFormat, QTextCodec *codec = 0);
+    static QByteArray logToByteArray(const TLog &log, const TLogLayout &layout, QTextCodec *codec = 0);
     static QByteArray priorityToString(Priority priority);
 
 protected:
     QByteArray layout_;
     QByteArray dateTimeFormat_;
+    TLogLayout compiledLayout_;
     Priority threshold_;
     QString  target_;
     QTextCodec *codec_;
@@ -0,0 +1,322 @@
+/* Copyright (c) 2012, AOYAMA Kazuharu
+ * All rights reserved.
+ *
+ * This software may be used and distributed according to the terms of
+ * the New BSD License, which is incorporated herein by reference.
+ */
+
+#include <QHash>
+#include <QMap>
+#include <QPair>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <TMetrics>
+#include <TWebApplication>
+#include <TAppSettings>
+
+/*
+  Buckets of histograms; values less than 16 have their own buckets,
+  the others are in one of 8 buckets per power of two, so that the
+  error is 12.5% at most.
+*/
+#define LINEAR_BUCKETS  16
+#define SUB_BUCKETS     8
+#define MAX_EXPONENT    40
+#define BUCKET_COUNT    (LINEAR_BUCKETS + (MAX_EXPONENT - 4) * SUB_BUCKETS)
+#define SHARD_BITS      4
+#define SHARD_COUNT     (1 << SHARD_BITS)
+
+typedef QPair<QByteArray, QByteArray> TMetricKey;  // name, labels
+
+struct THistogramData
+{
+    qint64 count;
+    qint64 sum;
+    qint64 buckets[BUCKET_COUNT];
+
+    THistogramData() : count(0), sum(0) { memset(buckets, 0, sizeof(buckets)); }
+    void add(const THistogramData &other);
+};
+
+
+void THistogramData::add(const THistogramData &other)
+{
+    count += other.count;
+    sum += other.sum;
+    for (int i = 0; i < BUCKET_COUNT; ++i) {
+        buckets[i] += other.buckets[i];
+    }
+}
+
+
+static inline int bucketIndex(qint64 value)
+{
+    if (value < LINEAR_BUCKETS)
+        return (value < 0) ? 0 : (int)value;
+
+    int exp = 4;
+    while (exp < MAX_EXPONENT - 1 && (value >> (exp + 1)) > 0) {
+        ++exp;
+    }
+    int sub = (int)((value >> (exp - 3)) & (SUB_BUCKETS - 1));
+    return qMin(LINEAR_BUCKETS + (exp - 4) * SUB_BUCKETS + sub, BUCKET_COUNT - 1);
+}
+
+
+static inline qint64 bucketUpperBound(int index)
+{
+    if (index < LINEAR_BUCKETS)
+        return index;
+
+    int exp = (index - LINEAR_BUCKETS) / SUB_BUCKETS + 4;
+    int sub = (index - LINEAR_BUCKETS) % SUB_BUCKETS;
+    return ((qint64)(SUB_BUCKETS + sub + 1) << (exp - 3)) - 1;
+}
+
+/*
+  Returns the index of the bucket whose upper bound is the nearest to
+  the \a value, so that an exported bucket consists of whole buckets.
+*/
+static inline int nearestEdgeIndex(qint64 value)
+{
+    int idx = bucketIndex(value);
+    if (idx > 0 && value - bucketUpperBound(idx - 1) < bucketUpperBound(idx) - value)
+        return idx - 1;
+    return idx;
+}
+
+
+class TMetricsData
+{
+public:
+    void mergeTo(TMetricsData &data) const;
+
+    QMutex mutex;
+    QHash<TMetricKey, qint64> counters;
+    QHash<TMetricKey, THistogramData> histograms;
+};
+
+static TMetricsData shards[SHARD_COUNT];
+static QMutex gaugeMutex;
+static QHash<TMetricKey, qint64> gauges;
+
+
+void TMetricsData::mergeTo(TMetricsData &data) const
+{
+    for (QHashIterator<TMetricKey, qint64> it(counters); it.hasNext(); ) {
+        it.next();
+        data.counters[it.key()] += it.value();
+    }
+
+    for (QHashIterator<TMetricKey, THistogramData> it(histograms); it.hasNext(); ) {
+        it.next();
+        data.histograms[it.key()].add(it.value());
+    }
+}
+
+
+/*
+  Returns the shard of the current thread. The thread IDs are hashed by
+  the Fibonacci hashing, since they are aligned addresses on some
+  systems.
+*/
+static TMetricsData *metricsData()
+{
+    quint64 id = (quint64)(quintptr)QThread::currentThreadId();
+    return &shards[(id * Q_UINT64_C(0x9E3779B97F4A7C15)) >> (64 - SHARD_BITS)];
+}
+
+
+static void appendSample(QByteArray &text, const QByteArray &name, const QByteArray &labels, const QByteArray &value)
+{
+    text += name;
+    if (!labels.isEmpty()) {
+        text += '{';
+        text += labels;
+        text += '}';
+    }
+    text += ' ';
+    text += value;
+    text += '\n';
+}
+
+
+static QByteArray secondsString(qint64 usecs)
+{
+    return QByteArray::number((double)usecs / 1000000.0, 'g', 12);
+}
+
+/*!
+  \class TMetrics
+  \brief The TMetrics class records counters and latency histograms of
+  the application server, and exports them in the text format of
+  Prometheus.
+
+  The metrics are recorded in a fixed number of shards selected by the
+  thread, so that the threads seldom wait for each other, and the
+  threads living only for a request cost nothing more. The metrics are
+  recorded only if Metrics.Enable is true in the application.ini file.
+
+  The upper bounds of the exported histogram buckets are the bounds of
+  the recorded buckets nearest to 100 usecs, 250 usecs, 500 usecs,
+  1 msec and so on, such as 0.001023 for 1 msec, so that the cumulative
+  counts are exact.
+*/
+
+/*!
+  Returns true if the metrics are enabled.
+*/
+bool TMetrics::isEnabled()
+{
+    return Tf::app()->settings().metricsEnabled;
+}
+
+/*!
+  Adds \a value to the counter \a name with the \a labels.
+*/
+void TMetrics::increment(const char *name, const QByteArray &labels, qint64 value)
+{
+    if (!isEnabled())
+        return;
+
+    TMetricsData *data = metricsData();
+    QMutexLocker locker(&data->mutex);
+    data->counters[TMetricKey(name, labels)] += value;
+}
+
+/*!
+  Records the time \a usecs in microseconds into the histogram \a name
+  with the \a labels. The histogram is exported in seconds.
+*/
+void TMetrics::observe(const char *name, const QByteArray &labels, qint64 usecs)
+{
+    if (!isEnabled())
+        return;
+
+    TMetricsData *data = metricsData();
+    QMutexLocker locker(&data->mutex);
+    THistogramData &hist = data->histograms[TMetricKey(name, labels)];
+    hist.count++;
+    hist.sum += usecs;
+    hist.buckets[bucketIndex(usecs)]++;
+}
+
+/*!
+  Sets the gauge \a name with the \a labels to \a value.
+*/
+void TMetrics::setGauge(const char *name, const QByteArray &labels, qint64 value)
+{
+    if (!isEnabled())
+        return;
+
+    QMutexLocker locker(&gaugeMutex);
+    gauges.insert(TMetricKey(name, labels), value);
+}
+
+/*!
+  Returns a label of the \a name and the \a value, escaping the value.
+*/
+QByteArray TMetrics::label(const char *name, const QByteArray &value)
+{
+    QByteArray lbl(name);
+    lbl.reserve(lbl.length() + value.length() + 3);
+    lbl += "=\"";
+    for (int i = 0; i < value.length(); ++i) {
+        char c = value[i];
+        if (c == '\\' || c == '"') {
+            lbl += '\\';
+            lbl += c;
+        } else if (c == '\n') {
+            lbl += "\\n";
+        } else {
+            lbl += c;
+        }
+    }
+    lbl += '"';
+    return lbl;
+}
+
+/*!
+  Returns the metrics of all the shards in the text format of
+  Prometheus.
+*/
+QByteArray TMetrics::exposition()
+{
+    // Nominal bounds of the exported buckets in microseconds
+    static const qint64 bounds[] = { 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000,
+                                     100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000, 0 };
+
+    TMetricsData total;
+    for (int i = 0; i < SHARD_COUNT; ++i) {
+        QMutexLocker locker(&shards[i].mutex);
+        shards[i].mergeTo(total);
+    }
+
+    QHash<TMetricKey, qint64> gaugeValues;
+    {
+        QMutexLocker locker(&gaugeMutex);
+        gaugeValues = gauges;
+    }
+
+    // Sorts by name
+    QMap<QByteArray, QList<TMetricKey> > names;
+    for (QHashIterator<TMetricKey, qint64> it(total.counters); it.hasNext(); ) {
+        const TMetricKey &key = it.next().key();
+        names[key.first] << key;
+    }
+    for (QHashIterator<TMetricKey, THistogramData> it(total.histograms); it.hasNext(); ) {
+        const TMetricKey &key = it.next().key();
+        names[key.first] << key;
+    }
+    for (QHashIterator<TMetricKey, qint64> it(gaugeValues); it.hasNext(); ) {
+        const TMetricKey &key = it.next().key();
+        names[key.first] << key;
+    }
+
+    QByteArray text;
+    for (QMapIterator<QByteArray, QList<TMetricKey> > it(names); it.hasNext(); ) {
+        it.next();
+        const QByteArray &name = it.key();
+        const QList<TMetricKey> &keys = it.value();
+
+        if (total.counters.contains(keys.first())) {
+            text += "# TYPE " + name + " counter\n";
+            for (QListIterator<TMetricKey> k(keys); k.hasNext(); ) {
+                const TMetricKey &key = k.next();
+                appendSample(text, name, key.second, QByteArray::number(total.counters.value(key)));
+            }
+
+        } else if (total.histograms.contains(keys.first())) {
+            text += "# TYPE " + name + " histogram\n";
+            for (QListIterator<TMetricKey> k(keys); k.hasNext(); ) {
+                const TMetricKey &key = k.next();
+                const THistogramData &hist = total.histograms[key];
+                QByteArray sep = (key.second.isEmpty()) ? QByteArray() : QByteArray(",");
+
+                qint64 cumulative = 0;
+                int idx = 0;
+                for (int b = 0; bounds[b] > 0; ++b) {
+                    int last = nearestEdgeIndex(bounds[b]);
+                    while (idx <= last) {
+                        cumulative += hist.buckets[idx++];
+                    }
+                    appendSample(text, name + "_bucket", key.second + sep + "le=\"" + secondsString(bucketUpperBound(last)) + '"',
+                                 QByteArray::number(cumulative));
+                }
+                appendSample(text, name + "_bucket", key.second + sep + "le=\"+Inf\"", QByteArray::number(hist.count));
+                appendSample(text, name + "_sum", key.second, secondsString(hist.sum));
+                appendSample(text, name + "_count", key.second, QByteArray::number(hist.count));
+            }
+
+        } else {
+            text += "# TYPE " + name + " gauge\n";
+            for (QListIterator<TMetricKey> k(keys); k.hasNext(); ) {
+                const TMetricKey &key = k.next();
+                appendSample(text, name, key.second, QByteArray::number(gaugeValues.value(key)));
+            }
+        }
+    }
+    return text;
+}
@@ -0,0 +1,22 @@
+#ifndef TMETRICS_H
+#define TMETRICS_H
+
+#include <QByteArray>
+#include <TGlobal>
+
+
+class T_CORE_EXPORT TMetrics
+{
+public:
+    static void increment(const char *name, const QByteArray &labels = QByteArray(), qint64 value = 1);
+    static void observe(const char *name, const QByteArray &labels, qint64 usecs);
+    static void setGauge(const char *name, const QByteArray &labels, qint64 value);
+    static QByteArray exposition();
+    static bool isEnabled();
+    static QByteArray label(const char *name, const QByteArray &value);
+
+private:
+    TMetrics();
+};
+
+#endif // TMETRICS_H
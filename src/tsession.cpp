@@ -7,6 +7,7 @@
 
 #include <TSession>
 #include <TWebApplication>
+#include <TAppSettings>
 #include <TActionController>
 
 /*!
@@ -36,5 +37,5 @@ void TSession::reset()
  */
 QByteArray TSession::sessionName()
 {
-    return Tf::app()->appSettings().value("Session.Name").toByteArray();
+    return Tf::app()->settings().sessionName;
 }
@@ -7,6 +7,7 @@
 
 #include <QCryptographicHash>
 #include <TWebApplication>
+#include <TAppSettings>
 #include <TSystemGlobal>
 #include "tsessioncookiestore.h"
 
@@ -15,17 +16,44 @@
   \brief The TSessionCookieStore class stores HTTP sessions into a cookie.
 */
 
+static QByteArray toBase64Url(const QByteArray &data)
+{
+    QByteArray ret = data.toBase64();
+    while (ret.endsWith('=')) {
+        ret.chop(1);
+    }
+    return ret.replace('+', '-').replace('/', '_');
+}
+
+
+static QByteArray fromBase64Url(const QByteArray &base64)
+{
+    QByteArray ba = base64;
+    ba.replace('-', '+').replace('_', '/');
+    while (ba.length() % 4) {
+        ba.append('=');
+    }
+    return QByteArray::fromBase64(ba);
+}
+
+
+static QByteArray digest(const QByteArray &data)
+{
+    return QCryptographicHash::hash(data + Tf::app()->settings().sessionSecret,
+                                    QCryptographicHash::Sha1);
+}
+
+/*!
+  Stores the \a session into the session ID as a cookie value, that is
+  the base64url encoded session data and its digest joined with '.'.
+*/
 bool TSessionCookieStore::store(TSession &session)
 {
     if (session.isEmpty())
         return true;
 
-    QByteArray ba;
-    QDataStream ds(&ba, QIODevice::WriteOnly);
-    ds << *static_cast<const QVariantHash *>(&session);
-    QByteArray digest = QCryptographicHash::hash(ba + Tf::app()->appSettings().value("Session.Secret").toByteArray(),
-                                                 QCryptographicHash::Sha1);
-    session.sessionId = ba.toHex() + "_" + digest.toHex();
+    QByteArray ba = serialize(session);
+    session.sessionId = toBase64Url(ba) + '.' + toBase64Url(digest(ba));
     return true;
 }
 
@@ -36,24 +64,22 @@ TSession TSessionCookieStore::find(const QByteArray &id, const QDateTime &)
     if (id.isEmpty())
         return session;
 
-    QList<QByteArray> balst = id.split('_');
+    // Hex encoded data joined with '_' in the older version
+    char sep = (id.contains('.')) ? '.' : '_';
+    QList<QByteArray> balst = id.split(sep);
     if (balst.count() == 2 && !balst.value(0).isEmpty() && !balst.value(1).isEmpty()) {
-        QByteArray ba = QByteArray::fromHex(balst.value(0));
-        QByteArray digest = QCryptographicHash::hash(ba + Tf::app()->appSettings().value("Session.Secret").toByteArray(),
-                                                     QCryptographicHash::Sha1);
+        QByteArray ba = (sep == '.') ? fromBase64Url(balst.value(0)) : QByteArray::fromHex(balst.value(0));
+        QByteArray dgst = (sep == '.') ? fromBase64Url(balst.value(1)) : QByteArray::fromHex(balst.value(1));
         
-        if (digest != QByteArray::fromHex(balst.value(1))) {
+        if (digest(ba) != dgst) {
             tSystemWarn("Recieved a tampered cookie or that of other web application.");
             //throw SecurityException("Tampered with cookie", __FILE__, __LINE__);
             return session;
         }
 
-        QDataStream ds(&ba, QIODevice::ReadOnly);
-        ds >> *static_cast<QVariantHash *>(&session);
-        
-        if (ds.status() != QDataStream::Ok) {
+        if (!deserialize(ba, session)) {
             tSystemError("Unable to load a session from the cookie store.");
-            session.clear();
+            return TSession();
         }
     }
     return session;
@@ -7,47 +7,122 @@
 
 #include <QFile>
 #include <QDir>
-#include <QDataStream>
 #include <TWebApplication>
 #include "tsessionfilestore.h"
+#ifdef Q_OS_WIN
+# include <sys/utime.h>
+#else
+# include <utime.h>
+#endif
 
 #define SESSION_DIR_NAME "session"
+#define INDEX_DIR_NAME   "index"
+#define INDEX_PERIOD     60
 
 /*!
   \class TSessionFileStore
   \brief The TSessionFileStore class stores HTTP sessions to files.
+  The files are sharded into subdirectories by the first two characters
+  of the session ID. When a session file is created, or is stored in
+  another minute than it was last modified, its ID is appended to an
+  index file of the current minute, so that the garbage collection
+  reads only the index files older than the expiration.
 */
 
-bool TSessionFileStore::store(TSession &session)
+static QString indexDirPath()
 {
-    QDir dir(sessionDirPath());
-    if (!dir.exists()) {
-        dir.mkpath(".");
+    return TSessionFileStore::sessionDirPath() + QLatin1String(INDEX_DIR_NAME) + QDir::separator();
+}
+
+
+/*
+  Returns true if the index file of the current period lacks the
+  session file \a fileInfo, that is, the file doesn't exist or was last
+  modified in another period. The index of the period of the last
+  modification always has the session.
+*/
+static bool isIndexRequired(const QFileInfo &fileInfo)
+{
+    uint period = QDateTime::currentDateTime().toTime_t() / INDEX_PERIOD;
+    return !fileInfo.exists() || fileInfo.lastModified().toTime_t() / INDEX_PERIOD != period;
+}
+
+
+static bool appendIndex(const QByteArray &id)
+{
+    uint period = QDateTime::currentDateTime().toTime_t() / INDEX_PERIOD;
+    QFile file(indexDirPath() + QString::number(period));
+    QIODevice::OpenMode mode = QIODevice::WriteOnly | QIODevice::Append | QIODevice::Unbuffered;
+
+    if (!file.open(mode)) {
+        QDir(indexDirPath()).mkpath(".");
+        if (!file.open(mode)) {
+            return false;
+        }
     }
-    
+    return file.write(id + '\n') == id.length() + 1;
+}
+
+
+bool TSessionFileStore::store(TSession &session)
+{
     bool res = false;
-    QFile file(sessionDirPath() + session.id());
-    if (file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
-        QDataStream ds(&file);
-        ds << *static_cast<const QVariantHash *>(&session);
-        res = (ds.status() == QDataStream::Ok);
+    QFile file(sessionFilePath(session.id()));
+    bool indexRequired = isIndexRequired(QFileInfo(file));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        QFileInfo(file).dir().mkpath(".");
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            return false;
+        }
+    }
+
+    QByteArray data = serialize(session);
+    res = (file.write(data) == data.length());
+    file.close();
+
+    if (res && indexRequired) {
+        appendIndex(session.id());
     }
     return res;
 }
 
 
+/*!
+  Updates the modification time of the file of the \a session.
+*/
+bool TSessionFileStore::touch(TSession &session)
+{
+    QFileInfo fi(sessionFilePath(session.id()));
+    if (!fi.exists()) {
+        return store(session);
+    }
+
+    bool indexRequired = isIndexRequired(fi);
+    QByteArray path = QFile::encodeName(fi.filePath());
+    if (utime(path.constData(), NULL) != 0) {
+        return store(session);
+    }
+
+    if (indexRequired) {
+        appendIndex(session.id());
+    }
+    return true;
+}
+
+
 TSession TSessionFileStore::find(const QByteArray &id, const QDateTime &modified)
 {
-    QFileInfo fi(sessionDirPath() + id);
+    QFileInfo fi(sessionFilePath(id));
+    if (!fi.exists()) {
+        fi.setFile(sessionDirPath() + id);  // stored by the older version
+    }
 
     if (fi.exists() && fi.lastModified() >= modified) { 
         QFile file(fi.filePath());
 
         if (file.open(QIODevice::ReadOnly)) {
-            QDataStream ds(&file);
             TSession result(id);
-            ds >> *static_cast<QVariantHash *>(&result);
-            if (ds.status() == QDataStream::Ok)
+            if (deserialize(file.readAll(), result))
                 return result; 
         }
     }
@@ -58,15 +133,45 @@ TSession TSessionFileStore::find(const QByteArray &id, const QDateTime &modified
 bool TSessionFileStore::remove(const QDateTime &garbageExpiration)
 {
     bool res = true;
+    uint period = garbageExpiration.toTime_t() / INDEX_PERIOD;
+
+    // Index files older than the expiration
+    QDir indexDir(indexDirPath());
+    QStringList indexes = indexDir.entryList(QDir::Files, QDir::Unsorted);
+    for (QStringListIterator it(indexes); it.hasNext(); ) {
+        const QString &name = it.next();
+        bool ok;
+        uint p = name.toUInt(&ok);
+        if (!ok || p >= period) {
+            continue;
+        }
+
+        QFile index(indexDir.filePath(name));
+        if (index.open(QIODevice::ReadOnly)) {
+            while (!index.atEnd()) {
+                QByteArray id = index.readLine().trimmed();
+                if (id.isEmpty())
+                    continue;
+
+                // Stored again after the index was written?
+                QFileInfo fi(sessionFilePath(id));
+                if (fi.exists() && fi.lastModified() < garbageExpiration) {
+                    res &= QFile::remove(fi.filePath());
+                }
+            }
+            index.close();
+        }
+        index.remove();
+    }
+
+    // Files stored by the older version
     QDir dir(sessionDirPath());
     if (dir.exists()) {
-        QList<QFileInfo> list = dir.entryInfoList(QDir::Files, QDir::Time | QDir::Reversed);
+        QList<QFileInfo> list = dir.entryInfoList(QDir::Files, QDir::Unsorted);
         for (QListIterator<QFileInfo> i(list); i.hasNext(); ) {
             const QFileInfo &fi = i.next();
             if (fi.lastModified() < garbageExpiration) {
                 res &= dir.remove(fi.fileName());
-            } else {
-                break;
             }
         }
     }
@@ -76,7 +181,8 @@ bool TSessionFileStore::remove(const QDateTime &garbageExpiration)
 
 bool TSessionFileStore::remove(const QByteArray &id)
 {
-    return QFile::remove(sessionDirPath() + id);
+    bool res = QFile::remove(sessionFilePath(id));
+    return QFile::remove(sessionDirPath() + id) || res;
 }
 
 
@@ -84,3 +190,11 @@ QString TSessionFileStore::sessionDirPath()
 {
     return Tf::app()->tmpPath() + QLatin1String(SESSION_DIR_NAME) + QDir::separator();
 }
+
+/*!
+  Returns the path of the file of the session \a id.
+*/
+QString TSessionFileStore::sessionFilePath(const QByteArray &id)
+{
+    return sessionDirPath() + QString::fromLatin1(id.left(2)) + QDir::separator() + QString::fromLatin1(id);
+}
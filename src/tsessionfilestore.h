@@ -12,8 +12,10 @@ public:
     bool store(TSession &session);
     bool remove(const QDateTime &garbageExpiration);
     bool remove(const QByteArray &id);
+    bool touch(TSession &session);
 
     static QString sessionDirPath();
+    static QString sessionFilePath(const QByteArray &id);
 };
 
 #endif // TSESSIONFILESTORE_H
@@ -5,42 +5,81 @@
  * the New BSD License, which is incorporated herein by reference.
  */
 
-#include <QHostInfo>
 #include <QCryptographicHash>
-#include <QThread>
+#include <QThreadStorage>
+#include <QtEndian>
 #include <TWebApplication>
+#include <TAppSettings>
 #include <TSessionStore>
+#include <TMetrics>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/time.h>
 #include "tsystemglobal.h"
 #include "tsessionmanager.h"
 #include "tsessionstorefactory.h"
 
-#define STORE_TYPE          "Session.StoreType"
-#define GC_PROBABILITY      "Session.GcProbability"
-#define GC_MAX_LIFE_TIME    "Session.GcMaxLifeTime"
-#define SESSION_LIFETIME    "Session.LifeTime"
+// Fits in the varchar(50) id column of the session table
+#define RANDOM_BYTES        20
+
+/*
+  Random byte generator for a thread, which hashes the secret seed
+  read from the OS and a counter.
+*/
+class TSessionRandomGenerator
+{
+public:
+    TSessionRandomGenerator();
+    QByteArray bytes(int length);
+
+private:
+    QByteArray seed;
+    quint64 counter;
+};
 
 
-static QByteArray randomString()
+TSessionRandomGenerator::TSessionRandomGenerator()
+    : counter(0)
 {
-    QByteArray data;
-    data.reserve(128);
-    
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-
-    data.append(QByteArray::number((uint)tv.tv_sec));
-    data.append(QByteArray::number((uint)tv.tv_usec));
-    data.append(QHostInfo::localHostName());
-    data.append(QByteArray::number(getpid()));
-    data.append(QByteArray::number((qulonglong)QThread::currentThread()));
-    data.append(QByteArray::number((qulonglong)qApp));
-    data.append(QByteArray::number(Tf::randXor128()));
-    return QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex();
+    char buf[32];
+    int len = 0;
+    int fd = ::open("/dev/urandom", O_RDONLY);
+    if (fd >= 0) {
+        len = ::read(fd, buf, sizeof(buf));
+        ::close(fd);
+    }
+
+    if (len == (int)sizeof(buf)) {
+        seed = QByteArray(buf, len);
+    } else {
+        // Fallback
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        seed.append((const char *)&tv, sizeof(tv));
+        seed.append(QByteArray::number(getpid()));
+        seed.append(QByteArray::number((qulonglong)this));
+        quint32 rnd[4];
+        Tf::randXor128(rnd, 4);
+        seed.append((const char *)rnd, sizeof(rnd));
+        tSystemWarn("Unable to read /dev/urandom; session IDs are less unpredictable");
+    }
+}
+
+
+QByteArray TSessionRandomGenerator::bytes(int length)
+{
+    QByteArray ret;
+    while (ret.length() < length) {
+        quint64 c = qToBigEndian(counter++);
+        ret += QCryptographicHash::hash(seed + QByteArray((const char *)&c, sizeof(c)), QCryptographicHash::Sha1);
+    }
+    ret.truncate(length);
+    return ret;
 }
 
 
+static QThreadStorage<TSessionRandomGenerator *> randomGenerators;
+
 TSessionManager::TSessionManager()
 { }
 
@@ -49,6 +88,15 @@ TSessionManager::~TSessionManager()
 { }
 
 
+static void observeStoreOperation(const QString &storeType, const char *operation, qint64 startTime)
+{
+    if (TMetrics::isEnabled()) {
+        QByteArray labels = TMetrics::label("store", storeType.toLatin1()) + ',' + TMetrics::label("op", operation);
+        TMetrics::observe("tf_session_store_duration_seconds", labels, tMicroseconds() - startTime);
+    }
+}
+
+
 TSession TSessionManager::findSession(const QByteArray &id)
 {
     T_TRACEFUNC();
@@ -58,11 +106,13 @@ TSession TSessionManager::findSession(const QByteArray &id)
     
     TSession session;
     if (!id.isEmpty()) {
+        qint64 startTime = tMicroseconds();
         TSessionStore *store = TSessionStoreFactory::create(storeType());
         if (store) {
             session = store->find(id, validCreated);
             delete store;
         }
+        observeStoreOperation(storeType(), "find", startTime);
     }
     return session;
 }
@@ -77,12 +127,39 @@ bool TSessionManager::store(TSession &session)
         return false;
     }
     
+    qint64 startTime = tMicroseconds();
     bool res = false;
     TSessionStore *store = TSessionStoreFactory::create(storeType());
     if (store) {
         res = store->store(session);
         delete store;
     }
+    observeStoreOperation(storeType(), "store", startTime);
+    return res;
+}
+
+
+/*!
+  Updates the modification time of the \a session not changed during
+  the request, without writing the data.
+*/
+bool TSessionManager::touch(TSession &session)
+{
+    T_TRACEFUNC();
+
+    if (session.id().isEmpty()) {
+        tSystemError("Internal Error  [%s:%d]", __FILE__, __LINE__); 
+        return false;
+    }
+    
+    qint64 startTime = tMicroseconds();
+    bool res = false;
+    TSessionStore *store = TSessionStoreFactory::create(storeType());
+    if (store) {
+        res = store->touch(session);
+        delete store;
+    }
+    observeStoreOperation(storeType(), "touch", startTime);
     return res;
 }
 
@@ -90,10 +167,12 @@ bool TSessionManager::store(TSession &session)
 bool TSessionManager::remove(const QByteArray &id)
 {
     if (!id.isEmpty()) {
+        qint64 startTime = tMicroseconds();
         TSessionStore *store = TSessionStoreFactory::create(storeType());
         if (store) {
             bool ret = store->remove(id);
             delete store;
+            observeStoreOperation(storeType(), "remove", startTime);
             return ret;
         }
     }
@@ -103,52 +182,64 @@ bool TSessionManager::remove(const QByteArray &id)
 
 QString TSessionManager::storeType() const
 {
-    return Tf::app()->appSettings().value(STORE_TYPE).toString().toLower();
+    return Tf::app()->settings().sessionStoreType;
 }
 
 
+/*!
+  Generates a new session ID, which consists of 160 random bits from the
+  generator of the current thread encoded in 40 hex digits. The ID tells
+  nothing about the server, and a collision is negligible without
+  looking up the session store.
+*/
 QByteArray TSessionManager::generateId()
 {
-    QByteArray id;
-    int i;
-    for (i = 0; i < 3; ++i) {
-        id = randomString();
-        if (findSession(id).isEmpty())
-            break;
+    if (!randomGenerators.hasLocalData()) {
+        randomGenerators.setLocalData(new TSessionRandomGenerator());
     }
-
-    if (i == 3)
-        throw RuntimeException("Unable to generate a unique session ID", __FILE__, __LINE__);
-    
-    return id;
+    return randomGenerators.localData()->bytes(RANDOM_BYTES).toHex();
 }
 
 
+/*!
+  Starts the garbage collection of sessions at the probability of the
+  \a Session.GcProbability setting. With the thread MPM, this function
+  does nothing since the application server collects the garbage
+  periodically in the background.
+  \sa removeGarbage()
+*/
 void TSessionManager::collectGarbage()
 {
-    static int prob = -1;
-
-    if (prob == -1) {
-        prob = Tf::app()->appSettings().value(GC_PROBABILITY).toInt();
+    if (Tf::app()->multiProcessingModule() == TWebApplication::Thread) {
+        return;
     }
 
+    int prob = Tf::app()->settings().sessionGcProbability;
     if (prob > 0) {
         int r = Tf::random(prob - 1);
         tSystemDebug("Session garbage collector : rand = %d", r);
 
         if (r == 0) {
-            tSystemDebug("Session garbage collector started");
-            
-            TSessionStore *store = TSessionStoreFactory::create(Tf::app()->appSettings().value(STORE_TYPE).toString());
-            if (store) {
-                int lifetime = Tf::app()->appSettings().value(GC_MAX_LIFE_TIME).toInt();
-                store->remove(QDateTime::currentDateTime().addSecs(-lifetime));
-                delete store;
-            }
+            removeGarbage();
         }
     }
 }
 
+/*!
+  Removes the sessions older than the \a Session.GcMaxLifeTime setting.
+*/
+void TSessionManager::removeGarbage()
+{
+    tSystemDebug("Session garbage collector started");
+
+    TSessionStore *store = TSessionStoreFactory::create(storeType());
+    if (store) {
+        int lifetime = Tf::app()->settings().sessionGcMaxLifeTime;
+        store->remove(QDateTime::currentDateTime().addSecs(-lifetime));
+        delete store;
+    }
+}
+
 
 TSessionManager &TSessionManager::instance()
 {
@@ -159,10 +250,5 @@ TSessionManager &TSessionManager::instance()
 
 int TSessionManager::sessionLifeTime()
 {
-    static int lifetime = -1;
-
-    if (lifetime < 0) {
-        lifetime = Tf::app()->appSettings().value(SESSION_LIFETIME).toInt();
-    }
-    return lifetime;
+    return Tf::app()->settings().sessionLifeTime;
 }
@@ -14,10 +14,12 @@ public:
 
     TSession findSession(const QByteArray &id);
     bool store(TSession &session);
+    bool touch(TSession &session);
     bool remove(const QByteArray &id);
     QString storeType() const;
     QByteArray generateId();
     void collectGarbage();
+    void removeGarbage();
 
     static TSessionManager &instance();
     static int sessionLifeTime();
@@ -0,0 +1,378 @@
+/* Copyright (c) 2012, AOYAMA Kazuharu
+ * All rights reserved.
+ *
+ * This software may be used and distributed according to the terms of
+ * the New BSD License, which is incorporated herein by reference.
+ */
+
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSharedMemory>
+#include <QCryptographicHash>
+#include <TWebApplication>
+#include <TAppSettings>
+#include "tsessionmemorystore.h"
+#include "tsystemglobal.h"
+
+#define SHARED_MEMORY_SIZE  "Session.SharedMemorySize"
+#define SHARED_MEMORY_KEY   "TreeFrogSessionStore"
+#define SERVER_PROCESSES    "MPM.thread.ServerProcesses"
+#define REUSE_PORT          "MPM.thread.ReusePort"
+#define SHARD_COUNT   16
+#define SLOT_SIZE     4096
+#define MAX_PROBE     32
+#define MAX_ID_LENGTH 64
+#define MAGIC_NUMBER  0x54465353  // "TFSS"
+#define LAYOUT_VERSION  2
+
+/*!
+  \class TSessionMemoryStore
+  \brief The TSessionMemoryStore class stores HTTP sessions in memory.
+  With the thread MPM of one server process, the sessions are held in a
+  hash sharded by the session ID, each shard guarded by its own mutex.
+  When more than one server process can serve the application, that is
+  with the prefork MPM, or with the thread MPM of several processes or
+  of the ReusePort option, they are held in a shared memory segment of
+  fixed size slots, which is kept after the server processes exit. The segment is keyed by the
+  web root path, so that applications on the same host never share it.
+*/
+
+struct SessionEntry
+{
+    QByteArray data;
+    uint modified;
+};
+
+struct SessionShard
+{
+    QMutex mutex;
+    QHash<QByteArray, SessionEntry> sessions;
+};
+
+struct SessionSharedHeader
+{
+    quint32 magic;
+    quint32 version;
+    quint32 slotHeaderSize;
+    quint32 slotSize;
+    quint32 slotCount;
+};
+
+struct SessionSlotHeader
+{
+    char id[MAX_ID_LENGTH];
+    quint32 modified;  // 0 means a free slot
+    quint32 length;
+};
+
+static SessionShard shards[SHARD_COUNT];
+static QSharedMemory *sharedMemory = 0;
+static QMutex sharedMemoryMutex;
+
+
+static inline SessionShard &shard(const QByteArray &id)
+{
+    return shards[qHash(id) % SHARD_COUNT];
+}
+
+
+/*
+  Returns true if more than one server process can serve the
+  application, including the old and new processes overlapping
+  on a rolling restart with the ReusePort option.
+*/
+static bool isShared()
+{
+    static int shared = -1;
+    if (shared < 0) {
+        const QSettings &settings = Tf::app()->appSettings();
+        shared = (Tf::app()->multiProcessingModule() == TWebApplication::Prefork
+                  || settings.value(SERVER_PROCESSES, 1).toInt() > 1
+                  || settings.value(REUSE_PORT).toBool()) ? 1 : 0;
+    }
+    return shared == 1;
+}
+
+/*
+  Returns the key of the shared memory segment for the application.
+*/
+static QString sharedMemoryKey()
+{
+    QByteArray hash = QCryptographicHash::hash(Tf::app()->webRootPath().toUtf8(), QCryptographicHash::Sha1);
+    return QLatin1String(SHARED_MEMORY_KEY) + QLatin1Char('_') + QString::fromLatin1(hash.toHex().left(16));
+}
+
+/*
+  Returns true if the segment \a shm has the layout of this version.
+*/
+static bool isCompatible(QSharedMemory *shm)
+{
+    if (shm->size() < (int)sizeof(SessionSharedHeader))
+        return false;
+
+    const SessionSharedHeader *header = (const SessionSharedHeader *)shm->data();
+    return header->magic == MAGIC_NUMBER && header->version == LAYOUT_VERSION
+        && header->slotHeaderSize == sizeof(SessionSlotHeader) && header->slotSize == SLOT_SIZE
+        && header->slotCount > 0
+        && sizeof(SessionSharedHeader) + (quint64)header->slotCount * SLOT_SIZE <= (quint64)shm->size();
+}
+
+/*!
+  Returns the shared memory segment, creating it if necessary.
+  The object is not deleted intentionally, so that the segment
+  outlives the server process.
+*/
+static QSharedMemory *sharedSegment()
+{
+    QMutexLocker locker(&sharedMemoryMutex);
+
+    if (!sharedMemory) {
+        QSharedMemory *shm = new QSharedMemory(sharedMemoryKey());
+        int size = Tf::app()->appSettings().value(SHARED_MEMORY_SIZE, 16 * 1024 * 1024).toInt();
+        size = qMax(size, (int)(sizeof(SessionSharedHeader) + SLOT_SIZE));
+
+        if (shm->create(size)) {
+            shm->lock();
+            memset(shm->data(), 0, shm->size());
+            SessionSharedHeader *header = (SessionSharedHeader *)shm->data();
+            header->magic = MAGIC_NUMBER;
+            header->version = LAYOUT_VERSION;
+            header->slotHeaderSize = sizeof(SessionSlotHeader);
+            header->slotSize = SLOT_SIZE;
+            header->slotCount = (shm->size() - sizeof(SessionSharedHeader)) / SLOT_SIZE;
+            shm->unlock();
+            tSystemDebug("Created shared memory of session store: %d bytes", shm->size());
+        } else if (shm->error() != QSharedMemory::AlreadyExists || !shm->attach()) {
+            tSystemError("Session.StoreType=memory unavailable; shared memory error: %s", qPrintable(shm->errorString()));
+            delete shm;
+            return 0;
+        }
+
+        shm->lock();
+        bool compatible = isCompatible(shm);
+        shm->unlock();
+        if (!compatible) {
+            tSystemError("Incompatible shared memory of session store: %s (remove it after stopping the servers)", qPrintable(shm->key()));
+            delete shm;
+            return 0;
+        }
+        sharedMemory = shm;
+    }
+    return sharedMemory;
+}
+
+
+static inline SessionSlotHeader *slotAt(QSharedMemory *shm, uint index)
+{
+    return (SessionSlotHeader *)((char *)shm->data() + sizeof(SessionSharedHeader) + index * SLOT_SIZE);
+}
+
+/*!
+  Returns the slot of the session \a id in the probe sequence, or if not
+  found, null. If \a victim is not null, it's set to a free slot or the
+  least recently modified slot of a garbage session, modified before
+  \a expiration, to store the session; or null if the all slots are used
+  by live sessions.
+*/
+static SessionSlotHeader *findSlot(QSharedMemory *shm, const QByteArray &id, SessionSlotHeader **victim = 0, uint expiration = 0)
+{
+    uint count = ((SessionSharedHeader *)shm->data())->slotCount;
+    uint start = qHash(id) % count;
+    SessionSlotHeader *candidate = 0;
+
+    for (uint i = 0; i < (uint)MAX_PROBE && i < count; ++i) {
+        SessionSlotHeader *slot = slotAt(shm, (start + i) % count);
+        if (slot->modified > 0 && qstrncmp(slot->id, id.constData(), MAX_ID_LENGTH) == 0) {
+            return slot;
+        }
+
+        if (slot->modified > 0 && slot->modified >= expiration) {
+            continue;  // live session
+        }
+        if (!candidate || (candidate->modified > 0 && slot->modified < candidate->modified)) {
+            candidate = slot;
+        }
+    }
+
+    if (victim) {
+        *victim = candidate;
+    }
+    return 0;
+}
+
+
+TSession TSessionMemoryStore::find(const QByteArray &id, const QDateTime &modified)
+{
+    uint expiration = modified.toTime_t();
+    QByteArray data;
+
+    if (isShared()) {
+        QSharedMemory *shm = sharedSegment();
+        if (!shm || id.length() >= MAX_ID_LENGTH)
+            return TSession();
+
+        shm->lock();
+        SessionSlotHeader *slot = findSlot(shm, id);
+        if (slot && slot->modified >= expiration) {
+            data = QByteArray((const char *)(slot + 1), slot->length);
+        }
+        shm->unlock();
+
+    } else {
+        SessionShard &sh = shard(id);
+        QMutexLocker locker(&sh.mutex);
+        QHash<QByteArray, SessionEntry>::iterator it = sh.sessions.find(id);
+        if (it != sh.sessions.end()) {
+            if (it.value().modified >= expiration) {
+                data = it.value().data;
+            } else {
+                sh.sessions.erase(it);
+            }
+        }
+    }
+
+    if (!data.isEmpty()) {
+        TSession result(id);
+        if (TSessionStore::deserialize(data, result))
+            return result;
+    }
+    return TSession();
+}
+
+
+bool TSessionMemoryStore::store(TSession &session)
+{
+    QByteArray data = TSessionStore::serialize(session);
+    uint now = QDateTime::currentDateTime().toTime_t();
+
+    if (isShared()) {
+        QSharedMemory *shm = sharedSegment();
+        if (!shm)
+            return false;
+
+        if (session.id().length() >= MAX_ID_LENGTH || data.length() > (int)(SLOT_SIZE - sizeof(SessionSlotHeader))) {
+            tSystemWarn("Session too large to store in shared memory: %d bytes", data.length());
+            return false;
+        }
+
+        // Sessions older than the GC lifetime are garbage to be replaced
+        uint expiration = now - qMin((uint)qMax(Tf::app()->settings().sessionGcMaxLifeTime, 0), now);
+        shm->lock();
+        SessionSlotHeader *slot = 0;
+        SessionSlotHeader *found = findSlot(shm, session.id(), &slot, expiration);
+        if (found) {
+            slot = found;
+        }
+
+        if (slot) {
+            memset(slot->id, 0, MAX_ID_LENGTH);
+            memcpy(slot->id, session.id().constData(), session.id().length());
+            slot->modified = now;
+            slot->length = data.length();
+            memcpy(slot + 1, data.constData(), data.length());
+        }
+        shm->unlock();
+
+        if (!slot) {
+            tSystemError("Session store full, failed to store session. Increase Session.SharedMemorySize.");
+        }
+        return slot != 0;
+    }
+
+    SessionShard &sh = shard(session.id());
+    QMutexLocker locker(&sh.mutex);
+    SessionEntry &entry = sh.sessions[session.id()];
+    entry.data = data;
+    entry.modified = now;
+    return true;
+}
+
+
+bool TSessionMemoryStore::touch(TSession &session)
+{
+    uint now = QDateTime::currentDateTime().toTime_t();
+    bool found = false;
+
+    if (isShared()) {
+        QSharedMemory *shm = sharedSegment();
+        if (!shm || session.id().length() >= MAX_ID_LENGTH)
+            return false;
+
+        shm->lock();
+        SessionSlotHeader *slot = findSlot(shm, session.id());
+        if (slot) {
+            slot->modified = now;
+            found = true;
+        }
+        shm->unlock();
+
+    } else {
+        SessionShard &sh = shard(session.id());
+        QMutexLocker locker(&sh.mutex);
+        QHash<QByteArray, SessionEntry>::iterator it = sh.sessions.find(session.id());
+        if (it != sh.sessions.end()) {
+            it.value().modified = now;
+            found = true;
+        }
+    }
+    return (found) ? true : store(session);
+}
+
+
+bool TSessionMemoryStore::remove(const QDateTime &garbageExpiration)
+{
+    uint expiration = garbageExpiration.toTime_t();
+
+    if (isShared()) {
+        QSharedMemory *shm = sharedSegment();
+        if (!shm)
+            return false;
+
+        shm->lock();
+        uint count = ((SessionSharedHeader *)shm->data())->slotCount;
+        for (uint i = 0; i < count; ++i) {
+            SessionSlotHeader *slot = slotAt(shm, i);
+            if (slot->modified > 0 && slot->modified < expiration) {
+                slot->modified = 0;
+            }
+        }
+        shm->unlock();
+        return true;
+    }
+
+    for (int i = 0; i < SHARD_COUNT; ++i) {
+        QMutexLocker locker(&shards[i].mutex);
+        QHash<QByteArray, SessionEntry>::iterator it = shards[i].sessions.begin();
+        while (it != shards[i].sessions.end()) {
+            if (it.value().modified < expiration) {
+                it = shards[i].sessions.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    return true;
+}
+
+
+bool TSessionMemoryStore::remove(const QByteArray &id)
+{
+    if (isShared()) {
+        QSharedMemory *shm = sharedSegment();
+        if (!shm || id.length() >= MAX_ID_LENGTH)
+            return false;
+
+        shm->lock();
+        SessionSlotHeader *slot = findSlot(shm, id);
+        if (slot) {
+            slot->modified = 0;
+        }
+        shm->unlock();
+        return slot != 0;
+    }
+
+    SessionShard &sh = shard(id);
+    QMutexLocker locker(&sh.mutex);
+    return sh.sessions.remove(id) > 0;
+}
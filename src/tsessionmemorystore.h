@@ -0,0 +1,18 @@
+#ifndef TSESSIONMEMORYSTORE_H
+#define TSESSIONMEMORYSTORE_H
+
+#include <TSessionStore>
+
+
+class T_CORE_EXPORT TSessionMemoryStore : public TSessionStore
+{
+public:
+    QString key() const { return "memory"; }
+    TSession find(const QByteArray &id, const QDateTime &modified);
+    bool store(TSession &session);
+    bool remove(const QDateTime &garbageExpiration);
+    bool remove(const QByteArray &id);
+    bool touch(TSession &session);
+};
+
+#endif // TSESSIONMEMORYSTORE_H
@@ -6,6 +6,7 @@
  */
 
 #include <TSqlORMapper>
+#include <TSqlQuery>
 #include <TCriteria>
 #include "tsessionsqlobjectstore.h"
 #include "tsessionobject.h"
@@ -19,20 +20,56 @@
 
 /* create table session ( id varchar(50) primary key, data blob, updated_at datetime ); */
 
+/*!
+  Stores the \a session with an upsert statement; INSERT ... ON DUPLICATE
+  KEY UPDATE for MySQL, INSERT OR REPLACE for SQLite, otherwise UPDATE
+  followed by INSERT if no row is updated.
+*/
 bool TSessionSqlObjectStore::store(TSession &session)
 {
-    TSqlORMapper<TSessionObject> mapper;
-    TCriteria cri(TSessionObject::Id, TSql::Equal, session.id());
-    TSessionObject so = mapper.findFirst(cri);
+    QByteArray data = serialize(session);
 
-    QDataStream ds(&so.data, QIODevice::WriteOnly);
-    ds << *static_cast<const QVariantHash *>(&session);
+    int databaseId = TSessionObject().databaseId();
+    QString driver = TActionContext::current()->getPrimaryDatabase(databaseId).driverName().toUpper();
+    QString table = TSqlQuery::escapeIdentifier(TSessionObject().tableName(), QSqlDriver::TableName, databaseId);
+    QDateTime now = QDateTime::currentDateTime();
+    TSqlQuery query(databaseId);
 
-    if (so.isEmpty()) {
-        so.id = session.id();
-        return so.create();
+    if (driver.startsWith(QLatin1String("QMYSQL"))) {
+        query.prepare(QLatin1String("INSERT INTO ") + table
+                      + QLatin1String(" (id, data, updated_at) VALUES (?, ?, ?) ON DUPLICATE KEY UPDATE data=VALUES(data), updated_at=VALUES(updated_at)"));
+    } else if (driver.startsWith(QLatin1String("QSQLITE"))) {
+        query.prepare(QLatin1String("INSERT OR REPLACE INTO ") + table + QLatin1String(" (id, data, updated_at) VALUES (?, ?, ?)"));
+    } else {
+        query.prepare(QLatin1String("UPDATE ") + table + QLatin1String(" SET data=?, updated_at=? WHERE id=?"));
+        query.addBind(data).addBind(now).addBind(QString(session.id()));
+        if (!query.exec()) {
+            return false;
+        }
+        if (query.numRowsAffected() > 0) {
+            return true;
+        }
+        query.prepare(QLatin1String("INSERT INTO ") + table + QLatin1String(" (id, data, updated_at) VALUES (?, ?, ?)"));
     }
-    return so.update();
+
+    query.addBind(QString(session.id())).addBind(data).addBind(now);
+    return query.exec();
+}
+
+/*!
+  Updates only the timestamp of the \a session.
+*/
+bool TSessionSqlObjectStore::touch(TSession &session)
+{
+    int databaseId = TSessionObject().databaseId();
+    QString table = TSqlQuery::escapeIdentifier(TSessionObject().tableName(), QSqlDriver::TableName, databaseId);
+    TSqlQuery query(databaseId);
+    query.prepare(QLatin1String("UPDATE ") + table + QLatin1String(" SET updated_at=? WHERE id=?"));
+    query.addBind(QDateTime::currentDateTime()).addBind(QString(session.id()));
+    if (!query.exec()) {
+        return false;
+    }
+    return (query.numRowsAffected() > 0) ? true : store(session);
 }
 
 
@@ -48,8 +85,8 @@ TSession TSessionSqlObjectStore::find(const QByteArray &id, const QDateTime &mod
         return TSession();
     
     TSession result(id);
-    QDataStream ds(&sess.data, QIODevice::ReadOnly);
-    ds >> *static_cast<QVariantHash *>(&result);
+    if (!deserialize(sess.data, result))
+        return TSession();
     return result;  
 }
 
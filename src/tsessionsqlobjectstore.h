@@ -12,6 +12,7 @@ public:
     bool store(TSession &session);
     bool remove(const QDateTime &garbageExpiration);
     bool remove(const QByteArray &id);
+    bool touch(TSession &session);
 };
 
 #endif // TSESSIONSQLOBJECTSTORE_H
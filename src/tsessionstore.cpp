@@ -5,9 +5,298 @@
  * the New BSD License, which is incorporated herein by reference.
  */
 
+#include <QDataStream>
+#include <QStringList>
+#include <QtEndian>
 #include <TSessionStore>
+#include "tsystemglobal.h"
+
+#define CODEC_MAGIC            'T'
+#define CODEC_VERSION          1
+#define FLAG_COMPRESSED        0x01
+#define COMPRESSION_THRESHOLD  256
 
 /*!
   \class TSessionStore
   \brief The TSessionStore is an abstract class that stores HTTP sessions.
 */
+
+/*!
+  \fn virtual bool TSessionStore::touch(TSession &session)
+
+  Updates the modification time of the \a session which has not been
+  changed since it was found. The default implementation stores the
+  session entirely; reimplement it to be cheaper.
+*/
+
+/*
+  Session codec, version 1
+    'T', version, flags, payload
+    payload : varint count, { varint length, UTF-8 key, value } * count
+    value   : tag, data  (varint lengths, zigzag encoded signed integers)
+  The payload is compressed by qCompress() if it gets smaller.
+*/
+
+enum ValueTag {
+    NullTag = 0,
+    FalseTag,
+    TrueTag,
+    IntTag,
+    UIntTag,
+    LongLongTag,
+    ULongLongTag,
+    DoubleTag,
+    StringTag,
+    ByteArrayTag,
+    StringListTag,
+    VariantTag = 255,  // QDataStream format
+};
+
+
+static inline void writeVarint(QByteArray &buf, quint64 value)
+{
+    while (value >= 0x80) {
+        buf.append(char((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    buf.append(char(value));
+}
+
+
+static inline bool readVarint(const QByteArray &buf, int &pos, quint64 &value)
+{
+    value = 0;
+    for (int shift = 0; pos < buf.length() && shift < 64; shift += 7) {
+        uchar c = buf.at(pos++);
+        value |= quint64(c & 0x7F) << shift;
+        if (!(c & 0x80))
+            return true;
+    }
+    return false;
+}
+
+
+static inline void writeBytes(QByteArray &buf, const QByteArray &bytes)
+{
+    writeVarint(buf, bytes.length());
+    buf.append(bytes);
+}
+
+
+static inline bool readBytes(const QByteArray &buf, int &pos, QByteArray &bytes)
+{
+    quint64 len;
+    if (!readVarint(buf, pos, len) || len > quint64(buf.length() - pos))
+        return false;
+
+    bytes = buf.mid(pos, len);
+    pos += len;
+    return true;
+}
+
+
+static void writeValue(QByteArray &buf, const QVariant &value)
+{
+    if (value.type() == QVariant::Invalid) {
+        buf.append(char(NullTag));
+        return;
+    }
+
+    switch (value.type()) {
+    case QVariant::Bool:
+        buf.append(char(value.toBool() ? TrueTag : FalseTag));
+        break;
+
+    case QVariant::Int:
+    case QVariant::LongLong: {
+        qint64 n = value.toLongLong();
+        buf.append(char((value.type() == QVariant::Int) ? IntTag : LongLongTag));
+        writeVarint(buf, (quint64(n) << 1) ^ quint64(n >> 63));
+        break; }
+
+    case QVariant::UInt:
+    case QVariant::ULongLong:
+        buf.append(char((value.type() == QVariant::UInt) ? UIntTag : ULongLongTag));
+        writeVarint(buf, value.toULongLong());
+        break;
+
+    case QVariant::Double: {
+        double d = value.toDouble();
+        quint64 bits;
+        memcpy(&bits, &d, sizeof(bits));
+        bits = qToLittleEndian(bits);
+        buf.append(char(DoubleTag));
+        buf.append((const char *)&bits, sizeof(bits));
+        break; }
+
+    case QVariant::String:
+        buf.append(char(StringTag));
+        writeBytes(buf, value.toString().toUtf8());
+        break;
+
+    case QVariant::ByteArray:
+        buf.append(char(ByteArrayTag));
+        writeBytes(buf, value.toByteArray());
+        break;
+
+    case QVariant::StringList: {
+        QStringList list = value.toStringList();
+        buf.append(char(StringListTag));
+        writeVarint(buf, list.count());
+        for (QStringListIterator it(list); it.hasNext(); ) {
+            writeBytes(buf, it.next().toUtf8());
+        }
+        break; }
+
+    default: {
+        QByteArray ba;
+        QDataStream ds(&ba, QIODevice::WriteOnly);
+        ds << value;
+        buf.append(char(VariantTag));
+        writeBytes(buf, ba);
+        break; }
+    }
+}
+
+
+static bool readValue(const QByteArray &buf, int &pos, QVariant &value)
+{
+    if (pos >= buf.length())
+        return false;
+
+    uchar tag = buf.at(pos++);
+    quint64 n;
+    QByteArray bytes;
+
+    switch (tag) {
+    case NullTag:
+        value = QVariant();
+        return true;
+
+    case FalseTag:
+    case TrueTag:
+        value = QVariant(tag == TrueTag);
+        return true;
+
+    case IntTag:
+    case LongLongTag:
+        if (!readVarint(buf, pos, n))
+            return false;
+        n = (n >> 1) ^ (quint64)-(qint64)(n & 1);
+        value = (tag == IntTag) ? QVariant((int)(qint64)n) : QVariant((qlonglong)n);
+        return true;
+
+    case UIntTag:
+    case ULongLongTag:
+        if (!readVarint(buf, pos, n))
+            return false;
+        value = (tag == UIntTag) ? QVariant((uint)n) : QVariant((qulonglong)n);
+        return true;
+
+    case DoubleTag: {
+        if (pos + (int)sizeof(n) > buf.length())
+            return false;
+        memcpy(&n, buf.constData() + pos, sizeof(n));
+        pos += sizeof(n);
+        n = qFromLittleEndian(n);
+        double d;
+        memcpy(&d, &n, sizeof(d));
+        value = QVariant(d);
+        return true; }
+
+    case StringTag:
+        if (!readBytes(buf, pos, bytes))
+            return false;
+        value = QVariant(QString::fromUtf8(bytes.constData(), bytes.length()));
+        return true;
+
+    case ByteArrayTag:
+        if (!readBytes(buf, pos, bytes))
+            return false;
+        value = QVariant(bytes);
+        return true;
+
+    case StringListTag: {
+        if (!readVarint(buf, pos, n))
+            return false;
+        QStringList list;
+        for (quint64 i = 0; i < n; ++i) {
+            if (!readBytes(buf, pos, bytes))
+                return false;
+            list << QString::fromUtf8(bytes.constData(), bytes.length());
+        }
+        value = QVariant(list);
+        return true; }
+
+    case VariantTag: {
+        if (!readBytes(buf, pos, bytes))
+            return false;
+        QDataStream ds(bytes);
+        ds >> value;
+        return ds.status() == QDataStream::Ok; }
+
+    default:
+        return false;
+    }
+}
+
+/*!
+  Serializes the \a session into a compact binary data.
+  \sa deserialize()
+*/
+QByteArray TSessionStore::serialize(const TSession &session)
+{
+    QByteArray payload;
+    payload.reserve(64 + session.count() * 32);
+    writeVarint(payload, session.count());
+    for (QVariantHash::const_iterator it = session.constBegin(); it != session.constEnd(); ++it) {
+        writeBytes(payload, it.key().toUtf8());
+        writeValue(payload, it.value());
+    }
+
+    QByteArray data;
+    data.append(CODEC_MAGIC).append(char(CODEC_VERSION));
+
+    if (payload.length() >= COMPRESSION_THRESHOLD) {
+        QByteArray compressed = qCompress(payload);
+        if (compressed.length() < payload.length()) {
+            return data.append(char(FLAG_COMPRESSED)).append(compressed);
+        }
+    }
+    return data.append(char(0)).append(payload);
+}
+
+/*!
+  Deserializes the \a data into the \a session. The data serialized by
+  QDataStream in the older version is also accepted.
+  \sa serialize()
+*/
+bool TSessionStore::deserialize(const QByteArray &data, TSession &session)
+{
+    if (data.length() < 3 || data.at(0) != CODEC_MAGIC) {
+        // QDataStream format
+        QDataStream ds(data);
+        ds >> *static_cast<QVariantHash *>(&session);
+        return ds.status() == QDataStream::Ok;
+    }
+
+    if (data.at(1) != CODEC_VERSION) {
+        tSystemError("Unsupported session data version: %d", data.at(1));
+        return false;
+    }
+
+    QByteArray payload = (data.at(2) & FLAG_COMPRESSED) ? qUncompress(data.mid(3)) : data.mid(3);
+    int pos = 0;
+    quint64 count;
+    if (!readVarint(payload, pos, count))
+        return false;
+
+    for (quint64 i = 0; i < count; ++i) {
+        QByteArray key;
+        QVariant value;
+        if (!readBytes(payload, pos, key) || !readValue(payload, pos, value))
+            return false;
+        session.insert(QString::fromUtf8(key.constData(), key.length()), value);
+    }
+    return true;
+}
@@ -16,6 +16,10 @@ public:
     virtual bool store(TSession &sesion) = 0;
     virtual bool remove(const QDateTime &garbageExpiration) = 0;
     virtual bool remove(const QByteArray &id) = 0;
+    virtual bool touch(TSession &session) { return store(session); }
+
+    static QByteArray serialize(const TSession &session);
+    static bool deserialize(const QByteArray &data, TSession &session);
 };
 
 #endif // TSESSIONSTORE_H
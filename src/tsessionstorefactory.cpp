@@ -17,6 +17,7 @@
 #include "tsessionsqlobjectstore.h"
 #include "tsessioncookiestore.h"
 #include "tsessionfilestore.h"
+#include "tsessionmemorystore.h"
 #include "tsystemglobal.h"
 
 static QMutex mutex;
@@ -46,7 +47,8 @@ QStringList TSessionStoreFactory::keys()
     QStringList ret;
     ret << TSessionSqlObjectStore().key()
         << TSessionCookieStore().key()
-        << TSessionFileStore().key();
+        << TSessionFileStore().key()
+        << TSessionMemoryStore().key();
 
     for (QListIterator<TSessionStoreInterface *> i(*ssifs); i.hasNext(); ) {
         ret << i.next()->keys();
@@ -78,6 +80,10 @@ TSessionStore *TSessionStoreFactory::create(const QString &key)
         ret = new TSessionFileStore;
         break;
 
+    case Memory:
+        ret = new TSessionMemoryStore;
+        break;
+
     case Plugin: {
         for (QListIterator<TSessionStoreInterface *> i(*ssifs); i.hasNext(); ) {
              TSessionStoreInterface *p = i.next();
@@ -107,6 +113,7 @@ void TSessionStoreFactory::loadPlugins()
         hash.insert(TSessionSqlObjectStore().key().toLower(), SqlObject);
         hash.insert(TSessionCookieStore().key().toLower(), Cookie);
         hash.insert(TSessionFileStore().key().toLower(), File);
+        hash.insert(TSessionMemoryStore().key().toLower(), Memory);
 
         QDir dir(Tf::app()->pluginPath());
         QStringList list = dir.entryList(QDir::Files);
@@ -19,6 +19,7 @@ protected:
         SqlObject,
         Cookie,
         File,
+        Memory,
         Plugin,
     };
 
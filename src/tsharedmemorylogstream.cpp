@@ -8,6 +8,7 @@
 #include <QSharedMemory>
 #include <QListIterator>
 #include <TSystemGlobal>
+#include <TMetrics>
 #include "tsharedmemorylogstream.h"
 
 #define CREATE_KEY  "TreeFrogLogStream"
@@ -68,6 +69,7 @@ void TSharedMemoryLogStream::writeLog(const TLog &log)
     QList<TLog> logList = smRead();
     logList << log;
     if (smWrite(logList)) {
+        TMetrics::setGauge("tf_log_buffered_records", QByteArray(), logList.count());
         if (!timer.isActive())
             timer.start(200, this);
     } else {
@@ -12,9 +12,57 @@
 #include <TWebApplication>
 #include "tsystemglobal.h"
 
+#define REPLICA_RETRY_INTERVAL  30
+
 static TSqlDatabasePool *databasePool = 0;
 
 
+static inline QString replicaConnectionName(int databaseId, int replica, int index)
+{
+    return QString().sprintf("%02d_r%d_%d", databaseId, replica, index);
+}
+
+/*!
+  Returns the index of the replica from the connection name
+  \a connectionName, or -1 for a primary connection.
+*/
+static inline int replicaIndex(const QString &connectionName)
+{
+    if (connectionName.length() < 4 || connectionName[3] != QLatin1Char('r'))
+        return -1;
+
+    bool ok;
+    int idx = connectionName.section(QLatin1Char('_'), 1, 1).mid(1).toInt(&ok);
+    return (ok) ? idx : -1;
+}
+
+
+static void closeExpiredConnections(QMap<QString, QDateTime> &map)
+{
+    QMap<QString, QDateTime>::iterator it = map.begin();
+    while (it != map.end()) {
+        QDateTime dt = it.value();
+        if (dt.addSecs(30) < QDateTime::currentDateTime()) {
+            QSqlDatabase::database(it.key(), false).close();
+            tSystemDebug("Closed database connection, name: %s", qPrintable(it.key()));
+            it = map.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+
+static void closeConnections(QMap<QString, QDateTime> &map)
+{
+    QMap<QString, QDateTime>::iterator it = map.begin();
+    while (it != map.end()) {
+        QSqlDatabase::database(it.key(), false).close();
+        it = map.erase(it);
+    }
+}
+
+
 static void cleanup()
 {
     if (databasePool) {
@@ -30,12 +78,7 @@ TSqlDatabasePool::~TSqlDatabasePool()
 
     QMutexLocker locker(&mutex);
     for (int j = 0; j < pooledConnections.count(); ++j) {
-        QMap<QString, QDateTime> &map = pooledConnections[j];
-        QMap<QString, QDateTime>::iterator it = map.begin();
-        while (it != map.end()) {
-            QSqlDatabase::database(it.key(), false).close();
-            it = map.erase(it);
-        }
+        closeConnections(pooledConnections[j]);
         
         for (int i = 0; i < maxConnections; ++i) {
             QString name = QString::number(j) + '_' + QString::number(i);
@@ -46,6 +89,21 @@ TSqlDatabasePool::~TSqlDatabasePool()
             }
         }
     }
+
+    for (int j = 0; j < replicaHosts.count(); ++j) {
+        for (int r = 0; r < replicaHosts[j].count(); ++r) {
+            closeConnections(replicaHosts[j][r].pooledConnections);
+
+            for (int i = 0; i < maxConnections; ++i) {
+                QString name = replicaConnectionName(j, r, i);
+                if (QSqlDatabase::contains(name)) {
+                    QSqlDatabase::removeDatabase(name);
+                } else {
+                    break;
+                }
+            }
+        }
+    }
 }
 
 
@@ -78,6 +136,36 @@ void TSqlDatabasePool::init()
         }
 
         pooledConnections.append(QMap<QString, QDateTime>());
+
+        // Replica hosts, separated by comma
+        QVector<ReplicaHost> hosts;
+        QSettings &settings = Tf::app()->databaseSettings(j);
+        settings.beginGroup(dbEnvironment);
+        QStringList replicas = settings.value("ReplicaHostNames").toString().split(QLatin1Char(','), QString::SkipEmptyParts);
+        settings.endGroup();
+
+        for (QStringListIterator it(replicas); it.hasNext(); ) {
+            QString host = it.next().trimmed();
+            if (host.isEmpty())
+                continue;
+
+            ReplicaHost replica;
+            replica.hostName = host.section(QLatin1Char(':'), 0, 0);
+            replica.port = host.section(QLatin1Char(':'), 1, 1).toInt();
+            replica.downUntil = 0;
+
+            for (int i = 0; i < maxConnections; ++i) {
+                QSqlDatabase db = QSqlDatabase::addDatabase(type, replicaConnectionName(j, hosts.count(), i));
+                if (!db.isValid()) {
+                    tWarn("Parameter 'driverType' is invalid");
+                    break;
+                }
+            }
+            tSystemDebug("Add replica database. databaseId:%d host:%s", j, qPrintable(host));
+            hosts << replica;
+        }
+        replicaHosts.append(hosts);
+        replicaCounters.append(0);
     }
 }
 
@@ -123,7 +211,82 @@ QSqlDatabase TSqlDatabasePool::pop(int databaseId)
 }
 
 
-bool TSqlDatabasePool::openDatabase(QSqlDatabase &database, const QString &env, int databaseId)
+/*!
+  Pops a connection to one of the replica hosts of the database
+  \a databaseId, which is selected by round-robin. A host failed to
+  connect is skipped for a while. Returns an invalid object if no
+  replica is available.
+*/
+QSqlDatabase TSqlDatabasePool::popReplica(int databaseId)
+{
+    T_TRACEFUNC();
+    QMutexLocker locker(&mutex);
+
+    QSqlDatabase db;
+    if (databaseId < 0 || databaseId >= replicaHosts.count() || maxConnections <= 0)
+        return db;
+
+    QVector<ReplicaHost> &hosts = replicaHosts[databaseId];
+    uint now = QDateTime::currentDateTime().toTime_t();
+
+    for (int n = 0; n < hosts.count(); ++n) {
+        int r = replicaCounters[databaseId];
+        replicaCounters[databaseId] = (r + 1) % hosts.count();
+
+        ReplicaHost &host = hosts[r];
+        if (host.downUntil > now) {
+            continue;
+        }
+
+        QMap<QString, QDateTime>::iterator it = host.pooledConnections.begin();
+        while (it != host.pooledConnections.end()) {
+            db = QSqlDatabase::database(it.key(), false);
+            it = host.pooledConnections.erase(it);
+            if (db.isOpen()) {
+                tSystemDebug("pop database: %s", qPrintable(db.connectionName()));
+                return db;
+            } else {
+                tSystemError("Pooled database is not open: %s  [%s:%d]", qPrintable(db.connectionName()), __FILE__, __LINE__);
+            }
+        }
+
+        for (int i = 0; i < maxConnections; ++i) {
+            db = QSqlDatabase::database(replicaConnectionName(databaseId, r, i), false);
+            if (!db.isOpen()) {
+                break;
+            }
+        }
+
+        if (!db.isValid() || db.isOpen()) {
+            continue;  // no connection available
+        }
+
+        if (openDatabase(db, dbEnvironment, databaseId, host.hostName, host.port)) {
+            tSystemDebug("pop database: %s", qPrintable(db.connectionName()));
+            return db;
+        }
+
+        tSystemWarn("Replica database unavailable: %s", qPrintable(host.hostName));
+        host.downUntil = now + REPLICA_RETRY_INTERVAL;
+    }
+    return QSqlDatabase();
+}
+
+/*!
+  Returns true if the database \a databaseId has replica hosts;
+  otherwise returns false.
+*/
+bool TSqlDatabasePool::hasReplica(int databaseId) const
+{
+    return databaseId >= 0 && databaseId < replicaHosts.count() && !replicaHosts[databaseId].isEmpty();
+}
+
+/*!
+  Opens the \a database with the settings of \a databaseId in the
+  environment \a env. If \a hostName is not empty, connects to the host
+  \a hostName and the \a port instead of the setting.
+*/
+bool TSqlDatabasePool::openDatabase(QSqlDatabase &database, const QString &env, int databaseId, const QString &hostName, int port)
 {
     // Initiates database
     QSettings &settings = Tf::app()->databaseSettings(databaseId);
@@ -147,12 +310,13 @@ bool TSqlDatabasePool::openDatabase(QSqlDatabase &database, const QString &env,
     }
     database.setDatabaseName(databaseName);
     
-    QString hostName = settings.value("HostName").toString().trimmed();
-    tSystemDebug("Database HostName: %s", qPrintable(hostName));
-    if (!hostName.isEmpty())
-        database.setHostName(hostName);
+    QString host = (hostName.isEmpty()) ? settings.value("HostName").toString().trimmed() : hostName;
+    tSystemDebug("Database HostName: %s", qPrintable(host));
+    if (!host.isEmpty())
+        database.setHostName(host);
     
-    int port = settings.value("Port").toInt();
+    if (hostName.isEmpty() || port <= 0)
+        port = settings.value("Port").toInt();
     tSystemDebug("Database Port: %d", port);
     if (port > 0)
         database.setPort(port);
@@ -194,7 +358,13 @@ void TSqlDatabasePool::push(QSqlDatabase &database)
         bool ok;
         int databaseId = database.connectionName().left(2).toInt(&ok);
 
-        if (ok && databaseId >= 0 && databaseId < pooledConnections.count()) {
+        int replica = replicaIndex(database.connectionName());
+
+        if (ok && replica >= 0 && databaseId >= 0 && databaseId < replicaHosts.count()
+            && replica < replicaHosts[databaseId].count()) {
+            replicaHosts[databaseId][replica].pooledConnections.insert(database.connectionName(), QDateTime::currentDateTime());
+            tSystemDebug("push database: %s", qPrintable(database.connectionName()));
+        } else if (ok && replica < 0 && databaseId >= 0 && databaseId < pooledConnections.count()) {
             pooledConnections[databaseId].insert(database.connectionName(), QDateTime::currentDateTime());
             tSystemDebug("push database: %s", qPrintable(database.connectionName()));
         } else {
@@ -213,17 +383,12 @@ void TSqlDatabasePool::timerEvent(QTimerEvent *event)
         // Closes extra-connection
         if (mutex.tryLock()) {
             for (int i = 0; i < pooledConnections.count(); ++i) {
-                QMap<QString, QDateTime> &map = pooledConnections[i];
-                QMap<QString, QDateTime>::iterator it = map.begin();
-                while (it != map.end()) {
-                    QDateTime dt = it.value();
-                    if (dt.addSecs(30) < QDateTime::currentDateTime()) {
-                        QSqlDatabase::database(it.key(), false).close();
-                        tSystemDebug("Closed database connection, name: %s", qPrintable(it.key()));
-                        it = map.erase(it);
-                    } else {
-                        ++it;
-                    }
+                closeExpiredConnections(pooledConnections[i]);
+            }
+
+            for (int i = 0; i < replicaHosts.count(); ++i) {
+                for (int j = 0; j < replicaHosts[i].count(); ++j) {
+                    closeExpiredConnections(replicaHosts[i][j].pooledConnections);
                 }
             }
             mutex.unlock();
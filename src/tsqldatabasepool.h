@@ -18,14 +18,16 @@ class T_CORE_EXPORT TSqlDatabasePool : QObject
 public:
     ~TSqlDatabasePool();
     QSqlDatabase pop(int databaseId = 0);
+    QSqlDatabase popReplica(int databaseId = 0);
     void push(QSqlDatabase &database);
+    bool hasReplica(int databaseId) const;
     const QString &environment() const { return dbEnvironment; }
 
     static void instantiate();
     static TSqlDatabasePool *instance();
 
     static QString driverType(const QString &env, int databaseId);
-    static bool openDatabase(QSqlDatabase &database, const QString &env, int databaseId);
+    static bool openDatabase(QSqlDatabase &database, const QString &env, int databaseId, const QString &hostName = QString(), int port = 0);
 
 protected:
     void init();
@@ -36,8 +38,18 @@ private:
     
     TSqlDatabasePool(const QString &environment);
 
+    struct ReplicaHost
+    {
+        QString hostName;
+        int port;
+        uint downUntil;
+        QMap<QString, QDateTime> pooledConnections;
+    };
+
     int maxConnections;
     QVector<QMap<QString, QDateTime> > pooledConnections;
+    QVector<QVector<ReplicaHost> > replicaHosts;
+    QVector<int> replicaCounters;
     QMutex mutex;
     QString dbEnvironment;
     QBasicTimer timer;
@@ -8,6 +8,9 @@
 #include <QtSql>
 #include <QCoreApplication>
 #include <QMetaObject>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
 #include <TSqlObject>
 #include <TActionContext>
 #include <TSqlQuery>
@@ -15,6 +18,32 @@
 
 #define REVISION_PROPERTY_NAME  "lock_revision"
 
+typedef QHash<QString, int> PropertyIndexHash;
+static QHash<const QMetaObject *, PropertyIndexHash> propertyIndexCache;
+static QMutex propertyIndexMutex;
+
+
+/*
+  Returns a hash of the lowercase property names of the meta-object
+  to the property indexes. It is computed once per model type.
+*/
+static PropertyIndexHash propertyIndexHash(const QMetaObject *metaObject)
+{
+    QMutexLocker locker(&propertyIndexMutex);
+
+    QHash<const QMetaObject *, PropertyIndexHash>::const_iterator it = propertyIndexCache.constFind(metaObject);
+    if (it != propertyIndexCache.constEnd()) {
+        return it.value();
+    }
+
+    PropertyIndexHash hash;
+    for (int i = metaObject->propertyOffset(); i < metaObject->propertyCount(); ++i) {
+        hash.insert(QString(metaObject->property(i).name()).toLower(), i);
+    }
+    propertyIndexCache.insert(metaObject, hash);
+    return hash;
+}
+
 /*!
   \class TSqlObject
   \brief The TSqlObject class is the base class of ORM objects.
@@ -101,6 +130,33 @@ void TSqlObject::setRecord(const QSqlRecord &record, const QSqlError &error)
     sqlError = error;
 }
 
+/*!
+  Sets the \a record using the \a propertyIndexes which were returned
+  by propertyIndexes() for the same field layout. This avoids looking up
+  the properties by name for each record. Internal use.
+ */
+void TSqlObject::setRecord(const QSqlRecord &record, const QSqlError &error, const QVector<int> &propertyIndexes)
+{
+    QSqlRecord::operator=(record);
+    syncToObject(propertyIndexes);
+    sqlError = error;
+}
+
+/*!
+  Returns a vector of the property indexes corresponding to the fields
+  of the \a record; -1 is set for a field which has no property.
+  Internal use.
+ */
+QVector<int> TSqlObject::propertyIndexes(const QSqlRecord &record) const
+{
+    PropertyIndexHash hash = propertyIndexHash(metaObject());
+    QVector<int> indexes(record.count());
+    for (int i = 0; i < record.count(); ++i) {
+        indexes[i] = hash.value(record.fieldName(i).toLower(), -1);
+    }
+    return indexes;
+}
+
 /*!
   Inserts this properties into the database.
  */
@@ -140,12 +196,15 @@ bool TSqlObject::create()
     }
 
     QSqlQuery query(database);
+    qint64 usecs = tMicroseconds();
     bool ret = query.exec(ins);
-    tQueryLog("%s", qPrintable(ins));
+    TActionContext::current()->addSqlQuery(ins, tMicroseconds() - usecs, ret);
     sqlError = query.lastError();
     if (!ret) {
         tSystemError("SQL insert error: %s", qPrintable(sqlError.text()));
     } else {
+        TActionContext::current()->addModifiedTable(databaseId(), tableName());
+
         // Gets the last inserted value of auto-value field
         if (autoValueIndex() >= 0) {
             QVariant lastid = query.lastInsertId();
@@ -202,12 +261,27 @@ bool TSqlObject::update()
     upd.reserve(256);
     upd.append(QLatin1String("UPDATE ")).append(tableName()).append(QLatin1String(" SET "));
 
-    for (int i = metaObject()->propertyOffset(); i < metaObject()->propertyCount(); ++i) {
-        const char *propName = metaObject()->property(i).name();
-        QVariant newval = QObject::property(propName);
-        QVariant recval = QSqlRecord::value(QLatin1String(propName));
+    // Maps the properties to the fields of the record
+    const QMetaObject *metaObj = metaObject();
+    QVector<int> propIndexes = propertyIndexes(*this);
+    QVector<int> fieldIndexes(metaObj->propertyCount(), -1);
+    for (int i = 0; i < propIndexes.count(); ++i) {
+        if (propIndexes[i] >= 0) {
+            fieldIndexes[propIndexes[i]] = i;
+        }
+    }
+
+    for (int i = metaObj->propertyOffset(); i < metaObj->propertyCount(); ++i) {
+        int fieldIndex = fieldIndexes[i];
+        if (fieldIndex < 0) {
+            continue;
+        }
+
+        QMetaProperty prop = metaObj->property(i);
+        QVariant newval = prop.read(this);
+        QVariant recval = QSqlRecord::value(fieldIndex);
         if (recval.isValid() && recval != newval) {
-            upd.append(TSqlQuery::escapeIdentifier(QLatin1String(propName), QSqlDriver::FieldName, database));
+            upd.append(TSqlQuery::escapeIdentifier(QLatin1String(prop.name()), QSqlDriver::FieldName, database));
             upd.append(QLatin1Char('='));
             upd.append(TSqlQuery::formatValue(newval, database));
             upd.append(QLatin1String(", "));
@@ -234,13 +308,15 @@ bool TSqlObject::update()
     upd.append(where);
 
     QSqlQuery query(database);
+    qint64 usecs = tMicroseconds();
     bool res = query.exec(upd);
-    tQueryLog("%s", qPrintable(upd));    
+    TActionContext::current()->addSqlQuery(upd, tMicroseconds() - usecs, res);
     sqlError = query.lastError();
     if (!res) {
         tSystemError("SQL update error: %s", qPrintable(sqlError.text()));
         return false;
     }
+    TActionContext::current()->addModifiedTable(databaseId(), tableName());
     
     // Optimistic lock check
     if (revIndex >= 0 && query.numRowsAffected() != 1) {
@@ -294,13 +370,15 @@ bool TSqlObject::remove()
     del.append("=").append(TSqlQuery::formatValue(property(pkName), database));
 
     QSqlQuery query(database);
+    qint64 usecs = tMicroseconds();
     bool res = query.exec(del);
-    tQueryLog("%s", qPrintable(del));
+    TActionContext::current()->addSqlQuery(del, tMicroseconds() - usecs, res);
     sqlError = query.lastError();
     if (!res) {
         tSystemError("SQL delete error: %s", qPrintable(sqlError.text()));
         return false;
     }
+    TActionContext::current()->addModifiedTable(databaseId(), tableName());
     
     // Optimistic lock check
     if (query.numRowsAffected() != 1) {
@@ -337,11 +415,12 @@ bool TSqlObject::isModified() const
     if (isNew())
         return false;
 
-    for (int i = 0; i < QSqlRecord::count(); ++i) {
-        QString name = field(i).name().toLower();
-        int index = metaObject()->indexOfProperty(name.toLatin1().constData());
+    const QMetaObject *metaObj = metaObject();
+    QVector<int> propIndexes = propertyIndexes(*this);
+    for (int i = 0; i < propIndexes.count(); ++i) {
+        int index = propIndexes[i];
         if (index >= 0) {
-            if (value(name) != property(name.toLatin1().constData())) {
+            if (value(i) != metaObj->property(index).read(this)) {
                 return true;
             }
         }
@@ -352,12 +431,18 @@ bool TSqlObject::isModified() const
 
 void TSqlObject::syncToObject()
 {
-    int offset = metaObject()->propertyOffset();
-    for (int i = 0; i < QSqlRecord::count(); ++i) {
-        QString propertyName = field(i).name();
-        int index = metaObject()->indexOfProperty(propertyName.toLower().toLatin1().constData());
-        if (index >= offset) {
-            QObject::setProperty(propertyName.toLower().toLatin1().constData(), value(propertyName));
+    syncToObject(propertyIndexes(*this));
+}
+
+
+void TSqlObject::syncToObject(const QVector<int> &propertyIndexes)
+{
+    const QMetaObject *metaObj = metaObject();
+    int cnt = qMin(propertyIndexes.count(), QSqlRecord::count());
+    for (int i = 0; i < cnt; ++i) {
+        int index = propertyIndexes[i];
+        if (index >= 0) {
+            metaObj->property(index).write(this, QSqlRecord::value(i));
         }
     }
 }
@@ -6,6 +6,7 @@
 #include <QSqlError>
 #include <QDateTime>
 #include <QVariantHash>
+#include <QVector>
 #include <TGlobal>
 
 
@@ -23,6 +24,8 @@ public:
     virtual int autoValueIndex() const { return -1; }
     virtual int databaseId() const { return 0; }
     void setRecord(const QSqlRecord &record, const QSqlError &error);
+    void setRecord(const QSqlRecord &record, const QSqlError &error, const QVector<int> &propertyIndexes);
+    QVector<int> propertyIndexes(const QSqlRecord &record) const;
     bool create();
     bool update();
     bool remove();
@@ -38,6 +41,7 @@ public:
 protected:
     void syncToSqlRecord();
     void syncToObject();
+    void syncToObject(const QVector<int> &propertyIndexes);
 
 private:
     mutable QString tblName;
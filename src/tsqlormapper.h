@@ -7,12 +7,16 @@
 #include <TCriteria>
 #include <TCriteriaConverter>
 #include <TActionContext>
+#include <TSqlResultCache>
 #include "tsystemglobal.h"
 
 /*!
   \class TSqlORMapper
   \brief The TSqlORMapper class is a template class that provides
   functionality to object-relational mapping.
+  The find functions are executed on a replica database if the database
+  has replica hosts, unless the primary database has been used in the
+  action context by then; removeAll() is always executed on the primary.
   \sa TSqlObject
 */
 
@@ -27,6 +31,7 @@ public:
     void setLimit(int limit);
     void setOffset(int offset);
     void setSort(int column, TSql::SortOrder order);
+    void setCacheEnabled(bool enable);
     void reset();
 
     T findFirst(const TCriteria &cri = TCriteria());
@@ -36,6 +41,7 @@ public:
     T last() const;
     T value(int i) const;
     int removeAll(const TCriteria &cri = TCriteria());
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
 
 protected:
     void setFilter(const QString &filter);
@@ -44,6 +50,10 @@ protected:
     virtual QString selectStatement() const;
 
 private:
+    bool fetch();
+    bool selectRecords();
+    QString buildSelectStatement() const;
+
     Q_DISABLE_COPY(TSqlORMapper)
 
     QString queryFilter;
@@ -51,14 +61,18 @@ private:
     TSql::SortOrder sortOrder;
     int queryLimit;
     int queryOffset;
+    mutable QVector<int> propertyIndexes;
+    bool cacheEnabled;
+    bool fromCache;
+    QList<QSqlRecord> cachedRecords;
 };
 
 
 template <class T>
 inline TSqlORMapper<T>::TSqlORMapper()
-    : QSqlTableModel(0, TActionContext::current()->getDatabase(T().databaseId())),
+    : QSqlTableModel(0, TActionContext::current()->getReadDatabase(T().databaseId())),
       sortColumn(-1), sortOrder(TSql::AscendingOrder), queryLimit(0),
-      queryOffset(0)
+      queryOffset(0), cacheEnabled(false), fromCache(false)
 {
     setTable(T().tableName());
 }
@@ -79,7 +93,7 @@ inline T TSqlORMapper<T>::findFirst(const TCriteria &cri)
 
     int oldLimit = queryLimit;
     queryLimit = 1;
-    select();
+    fetch();
     queryLimit = oldLimit;
 
     tSystemDebug("rowCount: %d", rowCount());
@@ -99,7 +113,7 @@ inline T TSqlORMapper<T>::findByPrimaryKey(QVariant pk)
     TCriteria cri(idx, pk);
     TCriteriaConverter<T> conv(cri, database());
     setFilter(conv.toString());
-    select();
+    fetch();
     tSystemDebug("findByPrimaryKey() rowCount: %d", rowCount());
     return first();
 }
@@ -112,7 +126,7 @@ inline int TSqlORMapper<T>::find(const TCriteria &cri)
         TCriteriaConverter<T> conv(cri, database());
         setFilter(conv.toString());
     }
-    if (!select()) {
+    if (!fetch()) {
         return -1;
     }
     tSystemDebug("rowCount: %d", rowCount());
@@ -139,7 +153,12 @@ inline T TSqlORMapper<T>::value(int i) const
 {
     T rec;
     if (i >= 0 && i < rowCount()) {
-        rec.setRecord(record(i), QSqlError());
+        QSqlRecord r = (fromCache) ? cachedRecords.at(i) : record(i);
+        if (propertyIndexes.isEmpty()) {
+            // Maps the columns to the properties once
+            propertyIndexes = rec.propertyIndexes(r);
+        }
+        rec.setRecord(r, QSqlError(), propertyIndexes);
     } else {
         tSystemDebug("no such record, index: %d  rowCount:%d", i, rowCount());
     }
@@ -169,6 +188,66 @@ inline void TSqlORMapper<T>::setSort(int column, TSql::SortOrder order)
 }
 
 
+/*!
+ * Enables the result cache of the find functions if \a enable is true;
+ * otherwise disables it. The cached records are discarded when a
+ * transaction which wrote to the table is committed, or after the
+ * lifetime specified by the \a SqlResultCache.LifeTime setting.
+ * \sa TSqlResultCache
+ */
+template <class T>
+inline void TSqlORMapper<T>::setCacheEnabled(bool enable)
+{
+    cacheEnabled = enable;
+}
+
+
+template <class T>
+inline int TSqlORMapper<T>::rowCount(const QModelIndex &parent) const
+{
+    return (fromCache) ? cachedRecords.count() : QSqlTableModel::rowCount(parent);
+}
+
+
+/*!
+ * Selects the records, from the result cache if enabled.
+ */
+template <class T>
+inline bool TSqlORMapper<T>::fetch()
+{
+    cachedRecords.clear();
+    fromCache = false;
+
+    int databaseId = T().databaseId();
+    if (!cacheEnabled || !TActionContext::current()->isSqlResultCacheAvailable(databaseId)) {
+        return selectRecords();
+    }
+
+    QString query = buildSelectStatement();
+    if (TSqlResultCache::instance().find(databaseId, query, cachedRecords)) {
+        tSystemDebug("SQL result cache hit: %s", qPrintable(query));
+        fromCache = true;
+        return true;
+    }
+
+    uint generation = TSqlResultCache::instance().generation();
+    if (!selectRecords()) {
+        return false;
+    }
+
+    while (canFetchMore()) {
+        fetchMore();
+    }
+
+    QList<QSqlRecord> records;
+    for (int i = 0; i < QSqlTableModel::rowCount(); ++i) {
+        records << record(i);
+    }
+    TSqlResultCache::instance().insert(databaseId, tableName(), query, records, generation);
+    return true;
+}
+
+
 /*!
  * Sets the current filter to 'filter'.
  * The mapper doesn't re-selects it with the new filter,
@@ -181,8 +260,42 @@ inline void TSqlORMapper<T>::setFilter(const QString &filter)
 }
 
 
+/*!
+ * Selects the records from the database, adding the time to the
+ * action context.
+ */
+template <class T>
+inline bool TSqlORMapper<T>::selectRecords()
+{
+    qint64 usecs = tMicroseconds();
+    bool ret;
+    QSqlDatabase &db = TActionContext::current()->getReadDatabase(T().databaseId());
+    if (!db.isValid() || db.connectionName() == database().connectionName()) {
+        ret = select();
+    } else {
+        // The primary database has been used since the mapper was
+        // constructed; reads it to see the changes in the transaction
+        revertAll();
+        QSqlQuery sqlQuery(db);
+        ret = sqlQuery.exec(selectStatement());
+        setQuery(sqlQuery);
+        ret = ret && !lastError().isValid();
+    }
+    QString stmt = query().lastQuery();
+    TActionContext::current()->addSqlQuery((stmt.isEmpty() ? buildSelectStatement() : stmt), tMicroseconds() - usecs, ret);
+    return ret;
+}
+
+
 template <class T>
 inline QString TSqlORMapper<T>::selectStatement() const
+{
+    return buildSelectStatement();
+}
+
+
+template <class T>
+inline QString TSqlORMapper<T>::buildSelectStatement() const
 {
     QString query = QSqlTableModel::selectStatement();
     if (!queryFilter.isEmpty())
@@ -199,7 +312,6 @@ inline QString TSqlORMapper<T>::selectStatement() const
     if (queryOffset > 0) {
         query.append(QLatin1String(" OFFSET ")).append(QString::number(queryOffset));
     }
-    tQueryLog("%s", qPrintable(query));
     return query;
 }
 
@@ -220,12 +332,15 @@ inline int TSqlORMapper<T>::removeAll(const TCriteria &cri)
         del.append(QLatin1String(" WHERE ")).append(where);
     }
 
-    tQueryLog("%s", qPrintable(del));
-  
-    QSqlQuery sqlQuery(database());
-    if ( !sqlQuery.exec(del) ) {
+    // Writes to the primary database
+    QSqlQuery sqlQuery(TActionContext::current()->getDatabase(T().databaseId()));
+    qint64 usecs = tMicroseconds();
+    bool ret = sqlQuery.exec(del);
+    TActionContext::current()->addSqlQuery(del, tMicroseconds() - usecs, ret);
+    if (!ret) {
         return -1;
     }
+    TActionContext::current()->addModifiedTable(T().databaseId(), T().tableName());
     return sqlQuery.numRowsAffected();
 }
 
@@ -246,6 +361,9 @@ inline void TSqlORMapper<T>::clear()
     sortOrder = TSql::AscendingOrder;
     queryLimit = 0;
     queryOffset = 0;
+    propertyIndexes.clear();
+    fromCache = false;
+    cachedRecords.clear();
     
     // Don't call the setTable() here,
     // or it causes a segmentation fault.
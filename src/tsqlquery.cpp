@@ -26,14 +26,37 @@ static QMutex cacheMutex;
   Constructor.
  */
 TSqlQuery::TSqlQuery(const QString &query, int databaseId)
-    : QSqlQuery(query, TActionContext::current()->getDatabase(databaseId))
-{ }
+    : QSqlQuery(QString(), TActionContext::current()->getPrimaryDatabase(databaseId)), databaseId(databaseId), replicaEnabled(false)
+{
+    if (!query.isEmpty()) {
+        exec(query);
+    }
+}
 
 /*!
   Constructor.
  */
 TSqlQuery::TSqlQuery(int databaseId)
-    : QSqlQuery(QString(), TActionContext::current()->getDatabase(databaseId))
+    : QSqlQuery(QString(), TActionContext::current()->getPrimaryDatabase(databaseId)), databaseId(databaseId), replicaEnabled(false)
+{ }
+
+/*!
+  Constructor with the database connection \a database. The query
+  never begins a transaction.
+ */
+TSqlQuery::TSqlQuery(const QString &query, const QSqlDatabase &database)
+    : QSqlQuery(query, database), databaseId(-1), replicaEnabled(false)
+{ }
+
+/*!
+  Constructor with the \a database connection, to read, of the database
+  \a databaseId. A SELECT statement without locking is executed on the
+  database to read, which is a replica database if available; any other
+  statement is executed on the primary database in a transaction.
+  \sa TActionContext::getReadDatabase()
+ */
+TSqlQuery::TSqlQuery(int databaseId, const QSqlDatabase &database)
+    : QSqlQuery(QString(), database), databaseId(databaseId), replicaEnabled(true)
 { }
 
 
@@ -83,7 +106,7 @@ void TSqlQuery::clearCachedQueries()
 
 QString TSqlQuery::escapeIdentifier(const QString &identifier, QSqlDriver::IdentifierType type, int databaseId)
 {
-    return escapeIdentifier(identifier, type, TActionContext::current()->getDatabase(databaseId));
+    return escapeIdentifier(identifier, type, TActionContext::current()->getPrimaryDatabase(databaseId));
 }
 
 
@@ -100,7 +123,7 @@ QString TSqlQuery::escapeIdentifier(const QString &identifier, QSqlDriver::Ident
 
 QString TSqlQuery::formatValue(const QVariant &val, int databaseId)
 {
-    return formatValue(val, TActionContext::current()->getDatabase(databaseId));
+    return formatValue(val, TActionContext::current()->getPrimaryDatabase(databaseId));
 }
 
 
@@ -114,18 +137,92 @@ QString TSqlQuery::formatValue(const QVariant &val, const QSqlDatabase &database
 
 bool TSqlQuery::exec(const QString &query)
 {
+    switchDatabase(query, false);
+    qint64 usecs = tMicroseconds();
     bool ret = QSqlQuery::exec(query);
-    QString q = (ret) ? query : QLatin1String("(Query failed) ") + query;
-    tQueryLog("%s", qPrintable(q));
+    TActionContext::current()->addSqlQuery(query, tMicroseconds() - usecs, ret);
     return ret;
 }
 
 
 bool TSqlQuery::exec()
 {
+    switchDatabase(lastQuery(), true);
+    qint64 usecs = tMicroseconds();
     bool ret = QSqlQuery::exec();
     QString q = executedQuery();
-    QString str = (ret) ? q : (QLatin1String("(Query failed) ") + (q.isEmpty() ? lastQuery() : q));
-    tQueryLog("%s", qPrintable(str));
+    TActionContext::current()->addSqlQuery((q.isEmpty() ? lastQuery() : q), tMicroseconds() - usecs, ret);
     return ret;   
 }
+
+/*!
+  Returns true if the \a query is a SELECT statement without locking
+  rows; otherwise returns false.
+ */
+bool TSqlQuery::isSelectQuery(const QString &query)
+{
+    QString q = query.trimmed();
+    return q.startsWith(QLatin1String("SELECT"), Qt::CaseInsensitive)
+        && !q.contains(QLatin1String(" FOR UPDATE"), Qt::CaseInsensitive)
+        && !q.contains(QLatin1String(" FOR SHARE"), Qt::CaseInsensitive)
+        && !q.contains(QLatin1String(" LOCK IN SHARE MODE"), Qt::CaseInsensitive);
+}
+
+/*!
+  Begins a transaction of the database unless the \a query is a
+  statement only to read, such as SELECT without locking, and moves
+  the query to the primary database for it. If the query was
+  constructed with a database to read, a SELECT statement is moved to
+  the database to read.
+ */
+void TSqlQuery::switchDatabase(const QString &query, bool prepared)
+{
+    if (databaseId < 0)
+        return;
+
+    QString q = query.trimmed();
+    bool select = isSelectQuery(q);
+    bool read = select
+        || q.startsWith(QLatin1String("SHOW"), Qt::CaseInsensitive)
+        || q.startsWith(QLatin1String("EXPLAIN"), Qt::CaseInsensitive);
+
+    if (!read) {
+        QSqlDatabase &db = TActionContext::current()->getDatabase(databaseId);
+        if (replicaEnabled) {
+            moveTo(db, prepared);
+        }
+    } else if (replicaEnabled && select) {
+        // The primary database once used is returned to read
+        moveTo(TActionContext::current()->getReadDatabase(databaseId), prepared);
+    }
+}
+
+/*!
+  Moves the query to the \a database unless it's on the database.
+  If \a prepared is true, the last query is prepared again and the
+  values are bound again.
+ */
+void TSqlQuery::moveTo(const QSqlDatabase &database, bool prepared)
+{
+    if (!database.isValid() || database.driver() == driver())
+        return;
+
+    tSystemDebug("Switch the query to the database: %s", qPrintable(database.connectionName()));
+    if (!prepared) {
+        QSqlQuery::operator=(QSqlQuery(database));
+        return;
+    }
+
+    QString query = lastQuery();
+    QVector<QVariant> values;
+    int count = boundValues().count();
+    for (int i = 0; i < count; ++i) {
+        values << boundValue(i);
+    }
+
+    QSqlQuery::operator=(QSqlQuery(database));
+    QSqlQuery::prepare(query);
+    for (int i = 0; i < values.count(); ++i) {
+        bindValue(i, values[i]);
+    }
+}
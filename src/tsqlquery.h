@@ -10,6 +10,7 @@ class T_CORE_EXPORT TSqlQuery : public QSqlQuery
 public:
     TSqlQuery(const QString &query = QString(), int databaseId = 0);
     TSqlQuery(int databaseId);
+    TSqlQuery(const QString &query, const QSqlDatabase &database);
 
     TSqlQuery &prepare(const QString &query);
     bool load(const QString &filename);
@@ -26,6 +27,17 @@ public:
     static QString escapeIdentifier(const QString &identifier, QSqlDriver::IdentifierType type, const QSqlDatabase &database);
     static QString formatValue(const QVariant &val, int databaseId = 0);
     static QString formatValue(const QVariant &val, const QSqlDatabase &database);
+    static bool isSelectQuery(const QString &query);
+
+protected:
+    TSqlQuery(int databaseId, const QSqlDatabase &database);
+
+private:
+    void switchDatabase(const QString &query, bool prepared);
+    void moveTo(const QSqlDatabase &database, bool prepared);
+
+    int databaseId;
+    bool replicaEnabled;
 };
 
 
@@ -5,6 +5,8 @@
 #include <QList>
 #include <TSqlQuery>
 #include <TCriteriaConverter>
+#include <TSqlResultCache>
+#include <TActionContext>
 #include <TSystemGlobal>
 
 
@@ -14,22 +16,64 @@ class TSqlQueryORMapper : public TSqlQuery
 public:
     TSqlQueryORMapper(const QString &query = QString());
 
+    void setCacheEnabled(bool enable);
     T findFirst();
     QList<T> findAll();
     T value() const;
     QString fieldName(int index) const;
+
+protected:
+    T value(const QVector<int> &propertyIndexes) const;
+    QList<QSqlRecord> cachedRecords();
+
+private:
+    bool cacheEnabled;
 };
 
 
+/*!
+  Constructor. A SELECT statement without locking is executed on a
+  replica database in the actions which only read the database, if the
+  database of \a T has replica hosts; any other statement is executed
+  on the primary database in a transaction.
+  \sa TActionContext::getReadDatabase()
+*/
 template <class T>
 inline TSqlQueryORMapper<T>::TSqlQueryORMapper(const QString &query)
-    : TSqlQuery(query)
-{ }
+    : TSqlQuery(T().databaseId(), TActionContext::current()->getReadDatabase(T().databaseId())), cacheEnabled(false)
+{
+    if (!query.isEmpty()) {
+        exec(query);
+    }
+}
+
+/*!
+  Enables the result cache of findFirst() and findAll() if \a enable
+  is true; otherwise disables it. As the query can join any tables, the
+  cached records are discarded when a transaction which wrote to any
+  table of the database is committed, or after the lifetime specified
+  by the \a SqlResultCache.LifeTime setting.
+  \sa TSqlResultCache
+*/
+template <class T>
+inline void TSqlQueryORMapper<T>::setCacheEnabled(bool enable)
+{
+    cacheEnabled = enable;
+}
 
 
 template <class T>
 inline T TSqlQueryORMapper<T>::findFirst()
 {
+    if (cacheEnabled && TActionContext::current()->isSqlResultCacheAvailable(T().databaseId())) {
+        QList<QSqlRecord> records = cachedRecords();
+        T rec;
+        if (!records.isEmpty()) {
+            rec.setRecord(records.first(), QSqlError());
+        }
+        return rec;
+    }
+
     exec();
     return (next()) ? value() : T();
 }
@@ -38,10 +82,31 @@ inline T TSqlQueryORMapper<T>::findFirst()
 template <class T>
 inline QList<T> TSqlQueryORMapper<T>::findAll()
 {
-    exec();
     QList<T> list;
+    if (cacheEnabled && TActionContext::current()->isSqlResultCacheAvailable(T().databaseId())) {
+        QList<QSqlRecord> records = cachedRecords();
+        QVector<int> propertyIndexes;
+        for (QListIterator<QSqlRecord> i(records); i.hasNext(); ) {
+            const QSqlRecord &r = i.next();
+            T rec;
+            if (propertyIndexes.isEmpty()) {
+                propertyIndexes = rec.propertyIndexes(r);
+            }
+            rec.setRecord(r, QSqlError(), propertyIndexes);
+            list.append(rec);
+        }
+        return list;
+    }
+
+    exec();
+    if (size() > 0) {
+        list.reserve(size());
+    }
+
+    // Maps the columns to the properties once for all rows
+    QVector<int> propertyIndexes = T().propertyIndexes(record());
     while (next()) {
-        list.append(value());
+        list.append(value(propertyIndexes));
     }
     return list;
 }
@@ -57,6 +122,50 @@ inline T TSqlQueryORMapper<T>::value() const
 }
 
 
+template <class T>
+inline T TSqlQueryORMapper<T>::value(const QVector<int> &propertyIndexes) const
+{
+    T rec;
+    rec.setRecord(record(), lastError(), propertyIndexes);
+    return rec;
+}
+
+
+/*!
+  Returns the records of the query from the result cache. If not cached,
+  executes the query and caches the records.
+*/
+template <class T>
+inline QList<QSqlRecord> TSqlQueryORMapper<T>::cachedRecords()
+{
+    // Query and bound values make the cache key
+    QString key = lastQuery();
+    QMapIterator<QString, QVariant> it(boundValues());
+    while (it.hasNext()) {
+        it.next();
+        key += QLatin1Char('\n') + it.key() + QLatin1Char(':') + QString::number(it.value().userType())
+            + QLatin1Char(':') + ((it.value().isNull()) ? QLatin1String("NULL") : it.value().toString());
+    }
+
+    QList<QSqlRecord> records;
+    int databaseId = T().databaseId();
+    if (TSqlResultCache::instance().find(databaseId, key, records)) {
+        tSystemDebug("SQL result cache hit: %s", qPrintable(lastQuery()));
+        return records;
+    }
+
+    uint generation = TSqlResultCache::instance().generation();
+    if (exec()) {
+        while (next()) {
+            records << record();
+        }
+        // Depends on all the tables, as the query can join any tables
+        TSqlResultCache::instance().insert(databaseId, QString(), key, records, generation);
+    }
+    return records;
+}
+
+
 template <class T>
 inline QString TSqlQueryORMapper<T>::fieldName(int index) const
 {
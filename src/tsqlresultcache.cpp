@@ -0,0 +1,179 @@
+/* Copyright (c) 2012, AOYAMA Kazuharu
+ * All rights reserved.
+ *
+ * This software may be used and distributed according to the terms of
+ * the New BSD License, which is incorporated herein by reference.
+ */
+
+#include <QDateTime>
+#include <QMutexLocker>
+#include <TWebApplication>
+#include <TAppSettings>
+#include <TSqlResultCache>
+#include "tsystemglobal.h"
+
+#define SERVER_PROCESSES   "MPM.thread.ServerProcesses"
+
+/*!
+  \class TSqlResultCache
+  \brief The TSqlResultCache class caches the records selected by the
+  ORM mappers in process memory.
+
+  The results are keyed by the generated SQL, expire after the lifetime
+  specified by the \a SqlResultCache.LifeTime setting, and are discarded
+  when a transaction which wrote to the same table is committed.
+  A result of TSqlQueryORMapper depends on all the tables of the database
+  since the query can join any tables.
+
+  The cache lives in a server process and the other processes can not
+  discard it, so it is available only with the thread MPM of one server
+  process; otherwise it's disabled.
+  \sa TSqlORMapper::setCacheEnabled(), TSqlQueryORMapper::setCacheEnabled()
+*/
+
+
+TSqlResultCache::TSqlResultCache()
+    : invalidations(0), available(false)
+{
+    available = (Tf::app()->multiProcessingModule() == TWebApplication::Thread
+                 && Tf::app()->appSettings().value(SERVER_PROCESSES, 1).toInt() <= 1);
+
+    if (!available && lifeTime() > 0) {
+        tSystemWarn("SQL result cache is disabled; available only with the thread MPM of one server process");
+    }
+}
+
+/*!
+  Finds the records selected by the \a query on the database
+  \a databaseId. Returns true and sets the \a records if a valid
+  cache exists; otherwise returns false.
+ */
+bool TSqlResultCache::find(int databaseId, const QString &query, QList<QSqlRecord> &records)
+{
+    if (!available || lifeTime() <= 0)
+        return false;
+
+    QString key = cacheKey(databaseId, query);
+    uint now = QDateTime::currentDateTime().toTime_t();
+    QMutexLocker locker(&mutex);
+
+    QHash<QString, Entry>::iterator it = entries.find(key);
+    if (it == entries.end())
+        return false;
+
+    if (it.value().expiration <= now) {
+        tableQueries[it.value().tableKey].remove(key);
+        entries.erase(it);
+        return false;
+    }
+
+    records = it.value().records;
+    return true;
+}
+
+/*!
+  Caches the \a records selected from the \a table by the \a query on
+  the database \a databaseId. If the \a table is empty, the records
+  are discarded when any table of the database is written. The
+  \a generation is the value of generation() before the query was
+  executed; if any cache has been invalidated since then, the records
+  may be stale and are not cached.
+ */
+void TSqlResultCache::insert(int databaseId, const QString &table, const QString &query, const QList<QSqlRecord> &records, uint generation)
+{
+    int lifeTimeSecs = lifeTime();
+    if (!available || lifeTimeSecs <= 0)
+        return;
+
+    QString key = cacheKey(databaseId, query);
+    uint now = QDateTime::currentDateTime().toTime_t();
+    QMutexLocker locker(&mutex);
+
+    if (generation != invalidations)
+        return;
+
+    int maxEntries = Tf::app()->settings().sqlResultCacheMaxEntries;
+    if (maxEntries > 0 && entries.count() >= maxEntries) {
+        removeExpiredEntries(now);
+        if (entries.count() >= maxEntries) {
+            tSystemDebug("SQL result cache is full, cleared");
+            entries.clear();
+            tableQueries.clear();
+        }
+    }
+
+    Entry entry;
+    entry.records = records;
+    entry.tableKey = cacheKey(databaseId, table.toLower());
+    entry.expiration = now + lifeTimeSecs;
+    entries.insert(key, entry);
+    tableQueries[entry.tableKey].insert(key);
+}
+
+/*!
+  Discards the all cached results of the \a table on the database
+  \a databaseId, and the results which depend on all the tables of
+  the database.
+ */
+void TSqlResultCache::invalidate(int databaseId, const QString &table)
+{
+    QString tableKey = cacheKey(databaseId, table.toLower());
+    QMutexLocker locker(&mutex);
+
+    ++invalidations;
+    if (entries.isEmpty())
+        return;
+
+    QSet<QString> keys = tableQueries.take(tableKey);
+    keys.unite(tableQueries.take(cacheKey(databaseId, QString())));
+    for (QSetIterator<QString> i(keys); i.hasNext(); ) {
+        entries.remove(i.next());
+    }
+}
+
+/*!
+  Returns the lifetime in seconds of the cached results, specified by the
+  \a SqlResultCache.LifeTime setting.
+ */
+int TSqlResultCache::lifeTime() const
+{
+    return Tf::app()->settings().sqlResultCacheLifeTime;
+}
+
+/*!
+  Discards the all cached results.
+ */
+void TSqlResultCache::clear()
+{
+    QMutexLocker locker(&mutex);
+    ++invalidations;
+    entries.clear();
+    tableQueries.clear();
+}
+
+
+void TSqlResultCache::removeExpiredEntries(uint now)
+{
+    QHash<QString, Entry>::iterator it = entries.begin();
+    while (it != entries.end()) {
+        if (it.value().expiration <= now) {
+            tableQueries[it.value().tableKey].remove(it.key());
+            it = entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+
+QString TSqlResultCache::cacheKey(int databaseId, const QString &string)
+{
+    return QString::number(databaseId) + QLatin1Char(':') + string;
+}
+
+
+TSqlResultCache &TSqlResultCache::instance()
+{
+    static TSqlResultCache cache;
+    return cache;
+}
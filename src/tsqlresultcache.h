@@ -0,0 +1,49 @@
+#ifndef TSQLRESULTCACHE_H
+#define TSQLRESULTCACHE_H
+
+#include <QString>
+#include <QList>
+#include <QHash>
+#include <QSet>
+#include <QMutex>
+#include <QSqlRecord>
+#include <TGlobal>
+
+
+class T_CORE_EXPORT TSqlResultCache
+{
+public:
+    ~TSqlResultCache() { }
+
+    bool find(int databaseId, const QString &query, QList<QSqlRecord> &records);
+    void insert(int databaseId, const QString &table, const QString &query, const QList<QSqlRecord> &records, uint generation);
+    void invalidate(int databaseId, const QString &table);
+    void clear();
+    uint generation() const { return invalidations; }
+    bool isAvailable() const { return available; }
+    int lifeTime() const;
+
+    static TSqlResultCache &instance();
+
+private:
+    struct Entry
+    {
+        QList<QSqlRecord> records;
+        QString tableKey;
+        uint expiration;
+    };
+
+    TSqlResultCache();
+    void removeExpiredEntries(uint now);
+    static QString cacheKey(int databaseId, const QString &string);
+
+    QHash<QString, Entry> entries;             // query key -> entry
+    QHash<QString, QSet<QString> > tableQueries;  // table key -> query keys
+    QMutex mutex;
+    volatile uint invalidations;
+    bool available;
+
+    Q_DISABLE_COPY(TSqlResultCache)
+};
+
+#endif // TSQLRESULTCACHE_H
@@ -6,6 +6,7 @@
  */
 
 #include <TSqlTransaction>
+#include <TSqlResultCache>
 #include <TWebApplication>
 #include <TSystemGlobal>
 
@@ -15,7 +16,8 @@
 */
 
 TSqlTransaction::TSqlTransaction()
-    : enabled(true), databases(Tf::app()->databaseSettingsCount())
+    : enabled(true), databases(Tf::app()->databaseSettingsCount()),
+      modifiedTables(Tf::app()->databaseSettingsCount()), began(0), committed(0), rolledBack(0)
 { }
 
 
@@ -48,8 +50,10 @@ bool TSqlTransaction::begin(QSqlDatabase &database)
         return true;
     }
 
+    qint64 usecs = tMicroseconds();
     if (database.transaction()) {
-        tQueryLog("[BEGIN] [databaseId:%d]", id);
+        tQueryLog(tMicroseconds() - usecs, QString("[BEGIN] [databaseId:%1]").arg(id));
+        ++began;
     }
 
     databases[id] = database;
@@ -62,11 +66,19 @@ void TSqlTransaction::commit()
     for (int i = 0; i < databases.count(); ++i) {
         QSqlDatabase &db = databases[i];
         if (db.isValid()) {
+            qint64 usecs = tMicroseconds();
             if (db.commit()) {
-                tQueryLog("[COMMIT] [databaseId:%d]", i);
+                tQueryLog(tMicroseconds() - usecs, QString("[COMMIT] [databaseId:%1]").arg(i));
+                ++committed;
             }
         }
         db = QSqlDatabase();
+
+        // The other requests see the changes from now
+        for (QSetIterator<QString> it(modifiedTables[i]); it.hasNext(); ) {
+            TSqlResultCache::instance().invalidate(i, it.next());
+        }
+        modifiedTables[i].clear();
     }
 }
 
@@ -76,10 +88,28 @@ void TSqlTransaction::rollback()
     for (int i = 0; i < databases.count(); ++i) {
         QSqlDatabase &db = databases[i];
         if (db.isValid()) {
+            qint64 usecs = tMicroseconds();
             if (db.rollback()) {
-                tQueryLog("[ROLLBACK] [databaseId:%d]", i);
-            }            
+                tQueryLog(tMicroseconds() - usecs, QString("[ROLLBACK] [databaseId:%1]").arg(i));
+                ++rolledBack;
+            }
         }
         db = QSqlDatabase();
+        modifiedTables[i].clear();
+    }
+}
+
+/*!
+  Records that the \a table on the database \a databaseId is written.
+  If the transaction of the database is active, the result cache of the
+  table is discarded when it's committed; otherwise immediately.
+  \sa TSqlResultCache
+*/
+void TSqlTransaction::addModifiedTable(int databaseId, const QString &table)
+{
+    if (isActive(databaseId)) {
+        modifiedTables[databaseId].insert(table.toLower());
+    } else {
+        TSqlResultCache::instance().invalidate(databaseId, table);
     }
 }
@@ -2,6 +2,7 @@
 #define TSQLTRANSACTION_H
 
 #include <QVector>
+#include <QSet>
 #include <QSqlDatabase>
 #include <TGlobal>
 
@@ -18,12 +19,21 @@ public:
     bool begin(QSqlDatabase &database);
     void commit();
     void rollback();
+    void addModifiedTable(int databaseId, const QString &table);
     void setEnabled(bool enable);
     void setDisabled(bool disable);
+    bool isActive(int databaseId) const;
+    int beganCount() const { return began; }
+    int committedCount() const { return committed; }
+    int rolledBackCount() const { return rolledBack; }
 
 private:
     bool enabled;
     QVector<QSqlDatabase> databases;
+    QVector<QSet<QString> > modifiedTables;
+    int began;
+    int committed;
+    int rolledBack;
 };
 
 
@@ -38,4 +48,10 @@ inline void TSqlTransaction::setDisabled(bool disable)
     enabled = !disable;
 }
 
+
+inline bool TSqlTransaction::isActive(int databaseId) const
+{
+    return databaseId >= 0 && databaseId < databases.count() && databases[databaseId].isValid();
+}
+
 #endif // TSQLTRANSACTION_H
@@ -15,27 +15,71 @@
 #include <TWebApplication>
 #include <TLogger>
 #include <TLog>
+#include <TMetrics>
+#include <TAppSettings>
 #include "tsystemglobal.h"
 #include "taccesslogstream.h"
 #include "taccesslog.h"
+#if defined(Q_OS_WIN)
+# include <windows.h>
+#else
+# include <time.h>
+# include <sys/time.h>
+#endif
 
 static TAccessLogStream *accesslogstrm = 0;
 static TAccessLogStream *sqllogstrm = 0;
 static QFile systemLog;
-static QByteArray syslogLayout;
-static QByteArray syslogDateTimeFormat;
-static QByteArray accessLogLayout;
-static QByteArray accessLogDateTimeFormat;
+static TLogLayout syslogLayout;
+static TAccessLogLayout accessLogLayout;
 
 
 void writeAccessLog(const TAccessLog &log)
 {
     if (accesslogstrm) {
-        accesslogstrm->writeLog(log.toByteArray(accessLogLayout, accessLogDateTimeFormat));
+        QByteArray line = log.toByteArray(accessLogLayout);
+        accesslogstrm->writeLog(line);
+        TMetrics::increment("tf_access_log_bytes_total", QByteArray(), line.length());
     }
 }
 
 
+/*!
+  Returns the current value of a monotonic clock in microseconds,
+  which is used to measure elapsed time.
+*/
+qint64 tMicroseconds()
+{
+#if defined(Q_OS_WIN)
+    static LARGE_INTEGER freq = { { 0, 0 } };
+    LARGE_INTEGER cnt;
+    if (!freq.QuadPart) {
+        QueryPerformanceFrequency(&freq);
+    }
+    QueryPerformanceCounter(&cnt);
+    return (cnt.QuadPart / freq.QuadPart) * 1000000 + (cnt.QuadPart % freq.QuadPart) * 1000000 / freq.QuadPart;
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (qint64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (qint64)tv.tv_sec * 1000000 + tv.tv_usec;
+#endif
+}
+
+
+static void cleanupSystemLoggers()
+{
+    // Writes the buffered logs
+    delete accesslogstrm;
+    accesslogstrm = 0;
+    delete sqllogstrm;
+    sqllogstrm = 0;
+}
+
+
 void tSetupSystemLoggers()
 {
     // Log directory
@@ -49,7 +93,9 @@ void tSetupSystemLoggers()
     
     // access log
     if (!accesslogstrm) {
-        accesslogstrm = new TAccessLogStream(Tf::app()->accessLogFilePath());
+        int interval = Tf::app()->appSettings().value("AccessLog.FlushInterval", 0).toInt();
+        accesslogstrm = new TAccessLogStream(Tf::app()->accessLogFilePath(), interval);
+        qAddPostRoutine(cleanupSystemLoggers);
     }
 
     // sql query log
@@ -59,10 +105,15 @@ void tSetupSystemLoggers()
             sqllogstrm = new TAccessLogStream(path);
     }
 
-    syslogLayout = Tf::app()->appSettings().value("SystemLog.Layout", "%d %5P %m%n").toByteArray();
-    syslogDateTimeFormat = Tf::app()->appSettings().value("SystemLog.DateTimeFormat", "yyyy-MM-ddThh:mm:ss").toByteArray();
-    accessLogLayout = Tf::app()->appSettings().value("AccessLog.Layout", "%h %d \"%r\" %s %O%n").toByteArray();
-    accessLogDateTimeFormat = Tf::app()->appSettings().value("AccessLog.DateTimeFormat", "yyyy-MM-ddThh:mm:ss").toByteArray();
+    // Compiles the layouts
+    QByteArray layout = Tf::app()->appSettings().value("SystemLog.Layout", "%d %5P %m%n").toByteArray();
+    QByteArray dateTimeFormat = Tf::app()->appSettings().value("SystemLog.DateTimeFormat", "yyyy-MM-ddThh:mm:ss").toByteArray();
+    syslogLayout = TLogLayout(layout, dateTimeFormat);
+
+    layout = Tf::app()->appSettings().value("AccessLog.Layout", "%h %d \"%r\" %s %O%n").toByteArray();
+    dateTimeFormat = Tf::app()->appSettings().value("AccessLog.DateTimeFormat", "yyyy-MM-ddThh:mm:ss").toByteArray();
+    QString format = Tf::app()->appSettings().value("AccessLog.Format", "text").toString().toLower();
+    accessLogLayout = TAccessLogLayout(layout, dateTimeFormat, (format == "json") ? TAccessLogLayout::JsonLines : TAccessLogLayout::Text);
 }
 
 
@@ -70,7 +121,7 @@ static void tSystemMessage(int priority, const char *msg, va_list ap)
 {
     static QSystemSemaphore semaphore("TreeFrogSystemLog", 1, QSystemSemaphore::Open);
     TLog log(priority, QString().vsprintf(msg, ap).toLocal8Bit());
-    QByteArray buf = TLogger::logToByteArray(log, syslogLayout, syslogDateTimeFormat);
+    QByteArray buf = TLogger::logToByteArray(log, syslogLayout);
 
     semaphore.acquire();  // Acquires the semaphore for system log
     if (!systemLog.fileName().isEmpty() && systemLog.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
@@ -141,8 +192,27 @@ void tQueryLog(const char *msg, ...)
         va_list ap;
         va_start(ap, msg);
         TLog log(-1, QString().vsprintf(msg, ap).toLocal8Bit());
-        QByteArray buf = TLogger::logToByteArray(log, syslogLayout, syslogDateTimeFormat);
+        QByteArray buf = TLogger::logToByteArray(log, syslogLayout);
         sqllogstrm->writeLog(buf);
         va_end(ap);
     }
 }
+
+/*!
+  Writes the SQL \a query which took \a usecs microseconds to the SQL
+  query log. If SqlQuerySlowThreshold is set, only the queries slower
+  than it are written, with the time and the \a caller.
+*/
+void tQueryLog(qint64 usecs, const QString &query, const QString &caller)
+{
+    if (!sqllogstrm)
+        return;
+
+    int threshold = Tf::app()->settings().sqlQuerySlowThreshold;
+    if (threshold <= 0) {
+        tQueryLog("%s", qPrintable(query));
+    } else if (usecs >= (qint64)threshold * 1000) {
+        tQueryLog("(Slow query: %.1f msec) [%s] %s", usecs / 1000.0,
+                  (caller.isEmpty() ? "-" : qPrintable(caller)), qPrintable(query));
+    }
+}
@@ -1,9 +1,15 @@
 #ifndef TSYSTEMGLOBAL_H
 #define TSYSTEMGLOBAL_H
 
+#include <QString>
 #include <TGlobal>
 
-#define ENABLE_TO_TRACE_FUNCTION  0
+// Defined by the configure option --enable-trace
+#ifdef TF_TRACE_FUNCTION
+# define ENABLE_TO_TRACE_FUNCTION  1
+#else
+# define ENABLE_TO_TRACE_FUNCTION  0
+#endif
 
 class TAccessLog;
 
@@ -12,6 +18,8 @@ T_CORE_EXPORT void writeAccessLog(const TAccessLog &log); // write access log
 
 T_CORE_EXPORT void tSetupSystemLoggers();  // internal use
 
+T_CORE_EXPORT qint64 tMicroseconds();  // monotonic clock, internal use
+
 T_CORE_EXPORT void tSystemError(const char *, ...) // system error message
 #if defined(Q_CC_GNU) && !defined(__INSURE__)
     __attribute__ ((format (printf, 1, 2)))
@@ -48,20 +56,26 @@ T_CORE_EXPORT void tQueryLog(const char *, ...) // SQL query log
 #endif
 ;
 
-#if !defined(TF_NO_DEBUG) && ENABLE_TO_TRACE_FUNCTION
+T_CORE_EXPORT void tQueryLog(qint64 usecs, const QString &query, const QString &caller = QString()); // SQL query log with time
+
+T_CORE_EXPORT void tTraceEvent(const char *function, char phase);  // internal use
+
+T_CORE_EXPORT bool tDumpTrace(const QString &filePath);  // writes trace events in Chrome trace format
+
+#if ENABLE_TO_TRACE_FUNCTION
 
 class T_CORE_EXPORT TTraceFunc
 {
 public:
-    TTraceFunc(const char *funcname) : functionName(funcname) { }
-    ~TTraceFunc() { tSystemTrace("<- Leave %s()", functionName); }
+    TTraceFunc(const char *funcname) : functionName(funcname) { tTraceEvent(functionName, 'B'); }
+    ~TTraceFunc() { tTraceEvent(functionName, 'E'); }
 
 private:
     const char *functionName;
 };
 
-# define T_TRACEFUNC(fmt, ...)  TTraceFunc ___tracefunc(__func__);     \
-                                tSystemTrace("-> Enter %s() " fmt, __func__, ## __VA_ARGS__)
+// The arguments are not recorded, so that they are not evaluated
+# define T_TRACEFUNC(fmt, ...)  TTraceFunc ___tracefunc(Q_FUNC_INFO)
 
 #else
 # define T_TRACEFUNC(fmt, ...)
@@ -0,0 +1,208 @@
+/* Copyright (c) 2012, AOYAMA Kazuharu
+ * All rights reserved.
+ *
+ * This software may be used and distributed according to the terms of
+ * the New BSD License, which is incorporated herein by reference.
+ */
+
+#include <QFile>
+#include <QList>
+#include <QVector>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QAtomicInt>
+#include <QThreadStorage>
+#include <QCoreApplication>
+#include "tsystemglobal.h"
+
+#define TRACE_BUFFER_SIZE  4096   // number of events per thread
+
+
+struct TTraceEvent
+{
+    qint64 timestamp;  // in microseconds
+    const char *name;
+    int threadId;
+    char phase;        // 'B': enter, 'E': leave
+};
+
+/*
+  Ring buffer of trace events. It's written only by the thread which
+  owns it, and reused by another thread after the owner finished, so
+  that the events of finished threads are kept until dumped.
+*/
+class TTraceBuffer
+{
+public:
+    TTraceBuffer() : threadId(0), count(0) { }
+    void append(const char *name, char phase);
+    QVector<TTraceEvent> events() const;
+
+    int threadId;
+
+private:
+    TTraceEvent buffer[TRACE_BUFFER_SIZE];
+    volatile quint64 count;
+};
+
+
+void TTraceBuffer::append(const char *name, char phase)
+{
+    TTraceEvent &ev = buffer[count % TRACE_BUFFER_SIZE];
+    ev.timestamp = tMicroseconds();
+    ev.name = name;
+    ev.threadId = threadId;
+    ev.phase = phase;
+    ++count;
+}
+
+
+QVector<TTraceEvent> TTraceBuffer::events() const
+{
+    quint64 cnt = count;
+    int len = (int)qMin(cnt, (quint64)TRACE_BUFFER_SIZE);
+    QVector<TTraceEvent> evs(len);
+
+    for (int i = 0; i < len; ++i) {
+        evs[i] = buffer[(cnt - len + i) % TRACE_BUFFER_SIZE];
+    }
+    return evs;
+}
+
+/*
+  Holds the buffer of a thread and releases it when the thread finishes.
+*/
+class TTraceBufferHolder
+{
+public:
+    TTraceBufferHolder();
+    ~TTraceBufferHolder();
+
+    TTraceBuffer *buffer;
+};
+
+
+static QMutex bufferMutex;
+static QList<TTraceBuffer *> allBuffers;
+static QList<TTraceBuffer *> freeBuffers;
+static QAtomicInt threadCounter;
+static QThreadStorage<TTraceBufferHolder *> traceBuffers;
+
+
+TTraceBufferHolder::TTraceBufferHolder()
+    : buffer(0)
+{
+    QMutexLocker locker(&bufferMutex);
+    if (freeBuffers.isEmpty()) {
+        buffer = new TTraceBuffer;
+        allBuffers << buffer;
+    } else {
+        buffer = freeBuffers.takeLast();
+    }
+    buffer->threadId = threadCounter.fetchAndAddOrdered(1) + 1;
+}
+
+
+TTraceBufferHolder::~TTraceBufferHolder()
+{
+    QMutexLocker locker(&bufferMutex);
+    freeBuffers << buffer;
+}
+
+/*!
+  Records the trace event of the \a function into the buffer of the
+  current thread. The \a phase is 'B' on entering and 'E' on leaving.
+  Used by T_TRACEFUNC.
+*/
+void tTraceEvent(const char *function, char phase)
+{
+    TTraceBufferHolder *holder = traceBuffers.localData();
+    if (!holder) {
+        holder = new TTraceBufferHolder;
+        traceBuffers.setLocalData(holder);
+    }
+    holder->buffer->append(function, phase);
+}
+
+
+#if ENABLE_TO_TRACE_FUNCTION
+
+static QByteArray jsonString(const char *str)
+{
+    QByteArray json("\"");
+    for (const char *p = str; p && *p; ++p) {
+        if (*p == '"' || *p == '\\') {
+            json += '\\';
+            json += *p;
+        } else if ((uchar)*p >= 0x20) {
+            json += *p;
+        }
+    }
+    json += '"';
+    return json;
+}
+
+#endif
+
+/*!
+  Writes the trace events recorded by T_TRACEFUNC to the file
+  \a filePath in the Chrome trace event format, which can be viewed
+  with chrome://tracing. Returns true if successful.
+*/
+bool tDumpTrace(const QString &filePath)
+{
+#if ENABLE_TO_TRACE_FUNCTION
+    QList<TTraceBuffer *> buffers;
+    {
+        QMutexLocker locker(&bufferMutex);
+        buffers = allBuffers;
+    }
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        tSystemError("Failed to open the trace file: %s", qPrintable(filePath));
+        return false;
+    }
+
+    const QByteArray pid = QByteArray::number(QCoreApplication::applicationPid());
+    QByteArray json = "{\"traceEvents\":[\n";
+    bool first = true;
+    int num = 0;
+
+    for (QListIterator<TTraceBuffer *> it(buffers); it.hasNext(); ) {
+        QVector<TTraceEvent> evs = it.next()->events();
+        for (int i = 0; i < evs.count(); ++i) {
+            const TTraceEvent &ev = evs[i];
+            if (!first)
+                json += ",\n";
+            first = false;
+            json += "{\"name\":";
+            json += jsonString(ev.name);
+            json += ",\"ph\":\"";
+            json += ev.phase;
+            json += "\",\"ts\":";
+            json += QByteArray::number(ev.timestamp);
+            json += ",\"pid\":";
+            json += pid;
+            json += ",\"tid\":";
+            json += QByteArray::number(ev.threadId);
+            json += '}';
+            ++num;
+        }
+
+        if (json.length() > 64 * 1024) {
+            file.write(json);
+            json.clear();
+        }
+    }
+    json += "\n],\"displayTimeUnit\":\"ms\"}\n";
+    file.write(json);
+    file.close();
+
+    tSystemInfo("Wrote %d trace events to %s", num, qPrintable(filePath));
+    return true;
+#else
+    tSystemWarn("Function trace disabled, configure with --enable-trace. Not written: %s", qPrintable(filePath));
+    return false;
+#endif
+}
@@ -7,20 +7,21 @@
 
 #include <QFile>
 #include <QTextStream>
+#include <QAtomicPointer>
 #include <TWebApplication>
 #include <TSystemGlobal>
 #include <THttpUtility>
 #include "turlroute.h"
 
 
-static TUrlRoute *urlRoute = 0;
+static QAtomicPointer<TUrlRoute> urlRoute;
+static QList<TUrlRoute *> retiredRoutes;
 
 static void cleanup()
 {
-    if (urlRoute) {
-        delete urlRoute;
-        urlRoute = 0;
-    }
+    delete urlRoute.fetchAndStoreOrdered(0);
+    qDeleteAll(retiredRoutes);
+    retiredRoutes.clear();
 }
 
 
@@ -31,16 +32,40 @@ static void cleanup()
 void TUrlRoute::instantiate()
 {
     if (!urlRoute) {
-        urlRoute = new TUrlRoute;
-        urlRoute->parseConfigFile();
+        TUrlRoute *route = new TUrlRoute;
+        route->parseConfigFile();
+        urlRoute = route;
         qAddPostRoutine(cleanup);
     }
 }
 
+/*!
+ * Reads the routes config file again and replaces the routing table
+ * at once. The current table is left unchanged if the file can not be
+ * read. Call this in main thread.
+ */
+bool TUrlRoute::reload()
+{
+    if (!urlRoute) {
+        instantiate();
+        return true;
+    }
+
+    TUrlRoute *route = new TUrlRoute;
+    if (!route->parseConfigFile()) {
+        delete route;
+        return false;
+    }
+
+    // The old table is kept, which may be used by other threads
+    retiredRoutes << urlRoute.fetchAndStoreOrdered(route);
+    return true;
+}
+
 
 const TUrlRoute &TUrlRoute::instance()
 {
-    Q_CHECK_PTR(urlRoute);
+    Q_CHECK_PTR((TUrlRoute *)urlRoute);
     return *urlRoute;
 }
 
@@ -48,6 +48,7 @@ class T_CORE_EXPORT TUrlRoute
 {
 public:
     static void instantiate();
+    static bool reload();
     static const TUrlRoute &instance();
     TRouting findRouting(Tf::HttpMethod method, const QString &path) const;
 
@@ -9,10 +9,10 @@
 #include <QRegExp>
 #include <TViewHelper>
 #include <TWebApplication>
+#include <TAppSettings>
 #include <TActionView>
 #include <THttpUtility>
 
-#define ENABLE_CSRF_PROTECTION_MODULE "EnableCsrfProtectionModule"
 
 
 /*!
@@ -234,7 +234,7 @@ QString TViewHelper::radioButtonTag(const QString &name, const QString &value, b
 QString TViewHelper::inputAuthenticityTag() const
 {
     QString tag;
-    if (Tf::app()->appSettings().value(ENABLE_CSRF_PROTECTION_MODULE, true).toBool()) {
+    if (Tf::app()->settings().enableCsrfProtectionModule) {
         QString token = actionView()->authenticityToken();
         if (!token.isEmpty())
             tag = inputTag("hidden", "authenticity_token", token);
@@ -7,11 +7,14 @@
 
 #include <QDir>
 #include <QTextCodec>
+#include <QDateTime>
 #include <TWebApplication>
+#include <TAppSettings>
 #include <TSystemGlobal>
 #include <stdlib.h>
 #include <unistd.h>
 #include <sys/time.h>
+#include <signal.h>
 
 #define DEFAULT_INTERNET_MEDIA_TYPE   "text/plain"
 #define DEFAULT_DATABASE_ENVIRONMENT  "product"
@@ -38,6 +41,7 @@ TWebApplication::TWebApplication(int &argc, char **argv)
 #endif
       dbEnvironment(DEFAULT_DATABASE_ENVIRONMENT),
       appSetting(0),
+      settingsSnapshot(0),
       dbSettings(0),
       loggerSetting(0),
       validationSetting(0),
@@ -81,6 +85,7 @@ TWebApplication::TWebApplication(int &argc, char **argv)
     loggerSetting = new QSettings(configPath() + "logger.ini", QSettings::IniFormat, this);
     validationSetting = new QSettings(configPath() + "validation.ini", QSettings::IniFormat, this);
     mediaTypes = new QSettings(configPath() + "initializers" + QDir::separator() + "internet_media_types.ini", QSettings::IniFormat, this);
+    settingsSnapshot = new TAppSettings(*appSetting);
 
     // Gets codecs
     codecInternal = searchCodec(appSetting->value("InternalEncoding").toByteArray().trimmed().data());
@@ -108,7 +113,10 @@ TWebApplication::TWebApplication(int &argc, char **argv)
 
 
 TWebApplication::~TWebApplication()
-{ }
+{
+    delete (const TAppSettings *)settingsSnapshot;
+    qDeleteAll(retiredSettings);
+}
 
 
 int TWebApplication::exec()
@@ -164,6 +172,23 @@ QString TWebApplication::tmpPath() const
 }
 
 
+/*!
+  Re-reads the application settings file and replaces the settings
+  returned by settings() at once. The previous settings are kept
+  until the application exits, because other threads may be reading
+  them.
+*/
+void TWebApplication::reloadSettings()
+{
+    appSetting->sync();
+    const TAppSettings *newSettings = new TAppSettings(*appSetting);
+    const TAppSettings *old = settingsSnapshot.fetchAndStoreOrdered(newSettings);
+    if (old) {
+        retiredSettings << old;
+    }
+}
+
+
 bool TWebApplication::appSettingsFileExists() const
 {
     return !appSetting->allKeys().isEmpty();
@@ -211,7 +236,7 @@ QByteArray TWebApplication::internetMediaType(const QString &ext, bool appendCha
 
     QString type = mediaTypes->value(ext, DEFAULT_INTERNET_MEDIA_TYPE).toString();
     if (appendCharset && type.startsWith("text", Qt::CaseInsensitive)) {
-        type += "; charset=" + appSetting->value("HtmlContentCharset").toString();
+        type += "; charset=" + settings().htmlContentCharset;
     }
     return type.toLatin1();
 }
@@ -285,6 +310,27 @@ void TWebApplication::timerEvent(QTimerEvent *event)
     if (event->timerId() == timer.timerId()) {
         if (signalNumber() >= 0) {
             tSystemDebug("TWebApplication trapped signal  number:%d", signalNumber());
+#if defined(Q_OS_UNIX)
+            // Reloads or shuts down gracefully if someone handles it
+            if (signalNumber() == SIGHUP && receivers(SIGNAL(reloadRequested())) > 0) {
+                resetSignalNumber();
+                emit reloadRequested();
+                return;
+            }
+            if (signalNumber() == SIGQUIT && receivers(SIGNAL(gracefulShutdownRequested())) > 0) {
+                resetSignalNumber();
+                emit gracefulShutdownRequested();
+                return;
+            }
+            if (signalNumber() == SIGUSR2) {
+                resetSignalNumber();
+                // Dumps the trace events of T_TRACEFUNC
+                QString path = logPath() + QString("trace-%1-%2.json").arg(applicationPid())
+                    .arg(QDateTime::currentDateTime().toString("yyyyMMddhhmmss"));
+                tDumpTrace(path);
+                return;
+            }
+#endif
             exit(signalNumber());
         }
     } else {
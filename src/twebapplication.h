@@ -10,10 +10,12 @@
 #include <QVector>
 #include <QSettings>
 #include <QBasicTimer>
+#include <QAtomicPointer>
 #include <TGlobal>
 #include "qplatformdefs.h"
 
 class QTextCodec;
+class TAppSettings;
 
 
 class T_CORE_EXPORT TWebApplication
@@ -23,6 +25,7 @@ class T_CORE_EXPORT TWebApplication
     : public QCoreApplication
 #endif
 {
+    Q_OBJECT
 public:
     enum MultiProcessingModule {
         Invalid = 0,
@@ -48,6 +51,8 @@ public:
     bool appSettingsFileExists() const;
     QString appSettingsFilePath() const;
     QSettings &appSettings() const { return *appSetting; }
+    const TAppSettings &settings() const { return *settingsSnapshot; }
+    void reloadSettings();
     QSettings &databaseSettings(int databaseId) const;
     int databaseSettingsCount() const;
     bool isValidDatabaseSettings() const;
@@ -73,6 +78,10 @@ public:
     void ignoreUnixSignal(int sig, bool ignore = true);
 #endif
 
+signals:
+    void reloadRequested();
+    void gracefulShutdownRequested();
+
 protected:
     void timerEvent(QTimerEvent *event);
     static int signalNumber();
@@ -83,6 +92,8 @@ private:
     QString webRootAbsolutePath;
     QString dbEnvironment;
     QSettings *appSetting;
+    QAtomicPointer<const TAppSettings> settingsSnapshot;
+    QList<const TAppSettings *> retiredSettings;
     QVector<QSettings *> dbSettings;
     QSettings *loggerSetting;
     QSettings *validationSetting;
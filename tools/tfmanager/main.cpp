@@ -76,11 +76,12 @@ static void usage()
 {
     char text[] =
         "Usage: %1 [-d] [-e environment] [application-directory]\n"     \
-        "Usage: %1 [-k stop|abort|restart] [application-directory]\n"   \
+        "Usage: %1 [-k stop|abort|restart|reload|status] [application-directory]\n" \
         "Options:\n"                                                    \
         "  -d              : run as a daemon process\n"                 \
         "  -e environment  : specify an environment of the database settings\n" \
-        "  -k              : send signal to a manager process\n\n"      \
+        "  -k              : send signal to a manager process, or show\n" \
+        "                    the resource usage of the servers (status)\n\n" \
         "Type '%1 -h' to show this information.\n"                      \
         "Type '%1 -v' to show the program version.";
     
@@ -218,6 +219,19 @@ static int killTreeFrogProcess(const QString &cmd)
         pi.restart();
         printf("Sent a restart request\n");
 
+    } else if (cmd == "reload") {  // reload command
+        pi.reload();
+        printf("Sent a reload request\n");
+
+    } else if (cmd == "status") {  // status command
+        printf("TreeFrog manager process running  pid:%ld\n", (long)pid);
+        QFile status(ServerManager::statusFilePath());
+        if (status.open(QIODevice::ReadOnly)) {
+            printf("%s", status.readAll().constData());
+        } else {
+            printf("Resource usage not sampled yet; see Monitor.Interval\n");
+        }
+
     } else {
         usage();
         return 1;
@@ -238,6 +252,7 @@ int managerMain(int argc, char *argv[])
     app.watchUnixSignal(SIGTERM);
     app.watchUnixSignal(SIGINT);
     app.watchUnixSignal(SIGHUP);
+    app.watchUnixSignal(SIGUSR1);
 #elif defined(Q_OS_WIN)
     app.watchConsoleSignal();
 #endif
@@ -336,19 +351,21 @@ int managerMain(int argc, char *argv[])
 
     int ret = 0;
     QFile pidfile;
-    
+    ServerManager *manager = 0;
+
     for (;;) {
-        ServerManager *manager = 0;
+        ServerManager *newManager = 0;
         switch ( app.multiProcessingModule() ) {
         case TWebApplication::Thread: {
-            manager = new ServerManager(1, 1, 0, &app);
+            int num = qMax(app.appSettings().value("MPM.thread.ServerProcesses", 1).toInt(), 1);
+            newManager = new ServerManager(num, num, 0, &app);
             break; }
             
         case TWebApplication::Prefork: {
             int max = app.appSettings().value("MPM.prefork.MaxServers").toInt();
             int min = app.appSettings().value("MPM.prefork.MinServers").toInt();
             int spare = app.appSettings().value("MPM.prefork.SpareServers").toInt();
-            manager = new ServerManager(max, min, spare, &app);
+            newManager = new ServerManager(max, min, spare, &app);
             break; }
             
         default:
@@ -359,18 +376,52 @@ int managerMain(int argc, char *argv[])
         // Startup
         writeStartupLog();
         bool started;
-        if (listenPort > 0) {
+        bool reusePort = (app.multiProcessingModule() == TWebApplication::Thread
+                          && listenPort > 0 && app.appSettings().value("MPM.thread.ReusePort").toBool());
+
+        if (manager && manager->listeningSocketDescriptor() <= 0 && !reusePort) {
+            // No socket to share with new servers
+            manager->stop();
+            delete manager;
+            manager = 0;
+        }
+
+        if (manager && manager->listeningSocketDescriptor() > 0) {
+            // Rolling restart; new servers start on the listening socket
+            started = newManager->startWithSocket(manager->listeningSocketDescriptor());
+        } else if (listenPort > 0) {
             // TCP/IP
-            started = manager->start(QHostAddress::Any, listenPort);
+            started = newManager->start(QHostAddress::Any, listenPort);
         } else {
             // UNIX domain
-            started = manager->start(svrname);
+            started = newManager->start(svrname);
+        }
+
+        if (started && manager) {
+            if (reusePort) {
+                // Closing a SO_REUSEPORT socket drops the connections
+                // queued on it, so the old servers keep accepting until
+                // all the new servers listen. A generation replaced
+                // before that passes the signal on to its predecessor.
+                QObject::connect(newManager, SIGNAL(serversListening()), manager, SLOT(drain()));
+                QObject::connect(newManager, SIGNAL(serversListening()), manager, SIGNAL(serversListening()));
+            } else {
+                // Old servers finish their requests and exit
+                manager->drain();
+            }
         }
         
         if (!started) {
-            tSystemError("TreeFrog application server startup failed");
-            fprintf(stderr, "TreeFrog application server startup failed\n\n");
-            return 1;
+            delete newManager;
+            if (manager) {
+                tSystemError("TreeFrog application server restart failed");
+            } else {
+                tSystemError("TreeFrog application server startup failed");
+                fprintf(stderr, "TreeFrog application server startup failed\n\n");
+                return 1;
+            }
+        } else {
+            manager = newManager;
         }
         
         // tmp directory
@@ -389,14 +440,23 @@ int managerMain(int argc, char *argv[])
             tSystemError("File open failed: %s", qPrintable(pidfile.fileName()));
         }
         
-        ret = app.exec();
-        tSystemDebug("tfmanager returnCode:%d", ret);
-        manager->stop();
+        for (;;) {
+            ret = app.exec();
+            tSystemDebug("tfmanager returnCode:%d", ret);
+#if defined(Q_OS_UNIX)
+            if (ret == SIGUSR1) {
+                manager->reload();
+                continue;
+            }
+#endif
+            break;
+        }
         
         if (ret == 1) {  // means SIGHUP
-            tSystemDebug("Restarts TreeFrog application servers");
-            //continue;
+            tSystemInfo("Restarts TreeFrog application servers");
+            app.reloadSettings();
         } else {
+            manager->stop();
             break;
         }
     }
@@ -15,10 +15,15 @@ public:
     qint64 pid() const { return processId; }
     QString processName() const;
     bool exists() const;
+    qint64 residentMemorySize() const;  // in bytes
+    qint64 cpuTime() const;             // in msecs
+    int threadCount() const;
+    int fileDescriptorCount() const;
 
     void terminate();  // SIGTERM
     void kill();       // SIGKILL
     void restart();    // SIGHUP
+    void reload();     // SIGUSR1
     bool waitForTerminated(int msecs = 10000);
 
     static QList<qint64> killProcesses(const QString &processName);
@@ -8,6 +8,7 @@
 #include <QtCore>
 #include <sys/types.h>
 #include <signal.h>
+#include <unistd.h>
 #include "processinfo.h"
 
 namespace TreeFrog {
@@ -35,6 +36,68 @@ QString ProcessInfo::processName() const
 }
 
 
+/*
+  Returns the fields of /proc/<pid>/stat following the process name,
+  which may contain spaces; the first one is the state.
+*/
+static QList<QByteArray> readStatFields(qint64 pid)
+{
+    QList<QByteArray> fields;
+    if (pid > 0) {
+        QFile procfile(QLatin1String("/proc/") + QString::number(pid) + "/stat");
+        if (procfile.open(QIODevice::ReadOnly)) {
+            QByteArray stat = procfile.readAll();
+            int idx = stat.lastIndexOf(')');
+            if (idx > 0) {
+                fields = stat.mid(idx + 1).simplified().split(' ');
+            }
+        }
+    }
+    return fields;
+}
+
+
+qint64 ProcessInfo::residentMemorySize() const
+{
+    QList<QByteArray> fields = readStatFields(processId);
+    if (fields.count() < 22)
+        return -1;
+
+    return fields[21].toLongLong() * sysconf(_SC_PAGESIZE);  // rss
+}
+
+
+qint64 ProcessInfo::cpuTime() const
+{
+    QList<QByteArray> fields = readStatFields(processId);
+    if (fields.count() < 13)
+        return -1;
+
+    qint64 ticks = fields[11].toLongLong() + fields[12].toLongLong();  // utime + stime
+    return ticks * 1000 / sysconf(_SC_CLK_TCK);
+}
+
+
+int ProcessInfo::threadCount() const
+{
+    QList<QByteArray> fields = readStatFields(processId);
+    return (fields.count() < 18) ? -1 : fields[17].toInt();  // num_threads
+}
+
+
+int ProcessInfo::fileDescriptorCount() const
+{
+    if (processId <= 0)
+        return -1;
+
+    QDir fddir(QLatin1String("/proc/") + QString::number(processId) + "/fd");
+    if (!fddir.exists())
+        return -1;
+
+    return fddir.entryList(QDir::AllEntries | QDir::System | QDir::NoDotAndDotDot).count();
+}
+
+
 QList<qint64> ProcessInfo::allConcurrentPids()
 {
     QList<qint64> ret;
@@ -78,4 +141,12 @@ void ProcessInfo::restart()
     }
 }
 
+
+void ProcessInfo::reload()
+{
+    if (processId > 0) {
+        ::kill(processId, SIGUSR1);
+    }
+}
+
 } // namespace TreeFrog
@@ -9,6 +9,7 @@
 #include <sys/sysctl.h>
 #include <sys/types.h>
 #include <signal.h>
+#include <libproc.h>
 #include "processinfo.h"
 
 namespace TreeFrog {
@@ -34,6 +35,52 @@ QString ProcessInfo::processName() const
 }
 
 
+qint64 ProcessInfo::residentMemorySize() const
+{
+    struct proc_taskinfo ti;
+    if (processId <= 0 || proc_pidinfo(processId, PROC_PIDTASKINFO, 0, &ti, sizeof(ti)) != sizeof(ti))
+        return -1;
+
+    return ti.pti_resident_size;
+}
+
+
+qint64 ProcessInfo::cpuTime() const
+{
+    struct proc_taskinfo ti;
+    if (processId <= 0 || proc_pidinfo(processId, PROC_PIDTASKINFO, 0, &ti, sizeof(ti)) != sizeof(ti))
+        return -1;
+
+    return (ti.pti_total_user + ti.pti_total_system) / 1000000;  // nsecs to msecs
+}
+
+
+int ProcessInfo::threadCount() const
+{
+    struct proc_taskinfo ti;
+    if (processId <= 0 || proc_pidinfo(processId, PROC_PIDTASKINFO, 0, &ti, sizeof(ti)) != sizeof(ti))
+        return -1;
+
+    return ti.pti_threadnum;
+}
+
+
+int ProcessInfo::fileDescriptorCount() const
+{
+    if (processId <= 0)
+        return -1;
+
+    int size = proc_pidinfo(processId, PROC_PIDLISTFDS, 0, NULL, 0);
+    if (size <= 0)
+        return -1;
+
+    struct proc_fdinfo *fds = (struct proc_fdinfo *) new char[size];
+    size = proc_pidinfo(processId, PROC_PIDLISTFDS, 0, fds, size);
+    delete[] (char *)fds;
+    return (size > 0) ? size / (int)sizeof(struct proc_fdinfo) : -1;
+}
+
+
 QList<qint64> ProcessInfo::allConcurrentPids()
 {
     QList<qint64> ret;
@@ -82,4 +129,12 @@ void ProcessInfo::restart()
     }
 }
 
+
+void ProcessInfo::reload()
+{
+    if (processId > 0) {
+        ::kill(processId, SIGUSR1);
+    }
+}
+
 } // namespace TreeFrog
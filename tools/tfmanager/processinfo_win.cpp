@@ -36,6 +36,61 @@ QString ProcessInfo::processName() const
 }
 
 
+qint64 ProcessInfo::residentMemorySize() const
+{
+    qint64 ret = -1;
+    HANDLE hProcess = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, processId);
+    if (hProcess) {
+        PROCESS_MEMORY_COUNTERS pmc;
+        if (GetProcessMemoryInfo(hProcess, &pmc, sizeof(pmc))) {
+            ret = pmc.WorkingSetSize;
+        }
+        CloseHandle(hProcess);
+    }
+    return ret;
+}
+
+
+qint64 ProcessInfo::cpuTime() const
+{
+    qint64 ret = -1;
+    HANDLE hProcess = OpenProcess(PROCESS_QUERY_INFORMATION, FALSE, processId);
+    if (hProcess) {
+        FILETIME creation, exit, kernel, user;
+        if (GetProcessTimes(hProcess, &creation, &exit, &kernel, &user)) {
+            qint64 k = ((qint64)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+            qint64 u = ((qint64)user.dwHighDateTime << 32) | user.dwLowDateTime;
+            ret = (k + u) / 10000;  // 100 nsecs to msecs
+        }
+        CloseHandle(hProcess);
+    }
+    return ret;
+}
+
+
+int ProcessInfo::threadCount() const
+{
+    // Not supported
+    return -1;
+}
+
+
+int ProcessInfo::fileDescriptorCount() const
+{
+    // Counts the handles instead
+    int ret = -1;
+    HANDLE hProcess = OpenProcess(PROCESS_QUERY_INFORMATION, FALSE, processId);
+    if (hProcess) {
+        DWORD count;
+        if (GetProcessHandleCount(hProcess, &count)) {
+            ret = count;
+        }
+        CloseHandle(hProcess);
+    }
+    return ret;
+}
+
+
 static BOOL CALLBACK terminateProc(HWND hwnd, LPARAM procId)
 {
     DWORD currentPid = 0;
@@ -90,6 +145,13 @@ void ProcessInfo::restart()
 }
 
 
+void ProcessInfo::reload()
+{
+    // Restarts instead
+    restart();
+}
+
+
 QList<qint64> ProcessInfo::allConcurrentPids()
 {
     const int MAX_COUNT = 1024;
@@ -13,6 +13,13 @@
 #include <TLog>
 #include "qplatformdefs.h"
 #include "servermanager.h"
+#include "processinfo.h"
+#ifdef Q_OS_UNIX
+# include <signal.h>
+#endif
+#ifdef Q_OS_WIN
+# include <windows.h>
+#endif
 
 namespace TreeFrog {
 
@@ -22,15 +29,34 @@ namespace TreeFrog {
 #  define TFSERVER_CMD  INSTALL_PATH "/tadpole"
 #endif
 
-static QMap<QProcess *, int> serversStatus;
+#define REUSE_PORT  "MPM.thread.ReusePort"
+#define MONITOR_INTERVAL  "Monitor.Interval"
+#define MONITOR_MAX_SERVER_MEMORY  "Monitor.MaxServerMemory"
+#define SCALE_DOWN_DELAY  "MPM.prefork.ScaleDownDelay"
+
+const int MAX_SPAWN_BATCH = 32;
+const int SCALE_INTERVAL = 1000;  // msecs
+
+
+static qint64 processIdOf(const QProcess *process)
+{
+#if defined(Q_OS_WIN)
+    _PROCESS_INFORMATION *pinfo = process->pid();
+    return (pinfo) ? (qint64)pinfo->dwProcessId : -1;
+#else
+    return process->pid();
+#endif
+}
 
 
 ServerManager::ServerManager(int max, int min, int spare, QObject *parent)
-    : QObject(parent), listeningSocket(0), maxServers(max), minServers(min), spareServers(spare), running(false)
+    : QObject(parent), listeningSocket(0), maxServers(max), minServers(min), spareServers(spare), running(false), draining(false), serversReady(false), maxServerMemory(0),
+      scaleDownDelay(0), spareTarget(0), spawnBatch(1), acceptedCount(0), requestRate(0), queueDepth(0), lastBusyTime(0)
 {
     spareServers = qMax(spareServers, 0);
     minServers = qMax(minServers, 1);
     maxServers = qMax(maxServers, minServers);
+    spareTarget = spareServers;
 }
 
 
@@ -46,24 +72,34 @@ bool ServerManager::start(const QHostAddress &address, quint16 port)
         return true;
     
 #ifdef Q_OS_UNIX
-    int sd = TApplicationServer::nativeListen(address, port, TApplicationServer::NonCloseOnExec);
+    bool reusePort = (Tf::app()->multiProcessingModule() == TWebApplication::Thread
+                      && Tf::app()->appSettings().value(REUSE_PORT).toBool());
+    // A listening SO_REUSEPORT socket would take a share of the connections
+    // from the servers still listening, and reset them on closing, so that
+    // the socket is just bound to check the port.
+    int sd = (reusePort) ? TApplicationServer::nativeBind(address, port, TApplicationServer::NonCloseOnExec)
+        : TApplicationServer::nativeListen(address, port, TApplicationServer::NonCloseOnExec);
     if (sd <= 0) {
         tSystemError("Failed to create listening socket");
         fprintf(stderr, "Failed to create listening socket\n");
         return false;
     }
 
-    if (Tf::app()->multiProcessingModule() == TWebApplication::Prefork) {
-        listeningSocket = sd;
+    if (reusePort) {
+        // Just tried to bind a socket.
+        TF_CLOSE(sd);
+        // Each tfserver process will open a socket of that with SO_REUSEPORT.
     } else {
-        // Just tried to open a socket.
-        close(sd);
-        // tfserver process will open a socket of that.
+        // Keeps the socket, which is handed over to servers of the next
+        // generation on restart
+        listeningSocket = sd;
     }
 #endif
     
     running = true;
     ajustServers();
+    startMonitoring();
+    startScaling();
     tSystemInfo("TreeFrog application servers start up.  port:%d", port);
     return true;
 }
@@ -81,27 +117,53 @@ bool ServerManager::start(const QString &fileDomain)
         return false;
     }
     
-    if (Tf::app()->multiProcessingModule() == TWebApplication::Prefork) {
-        listeningSocket = sd;
-    } else {
-        // Just tried to open a socket.
-        close(sd);
-        // tfserver process will open a socket of that.
-    }
-    
+    listeningSocket = sd;
     running = true;
     ajustServers();
+    startMonitoring();
+    startScaling();
     tSystemInfo("TreeFrog application servers start up.  Domain file name:%s", qPrintable(fileDomain));
     return true;
 }
 
+/*!
+  Starts servers on the listening socket \a socketDescriptor, which is
+  still open in the servers of the previous generation.
+*/
+bool ServerManager::startWithSocket(int socketDescriptor)
+{
+    if (isRunning())
+        return true;
+
+    if (socketDescriptor <= 0) {
+        tSystemError("Invalid listening socket: %d", socketDescriptor);
+        return false;
+    }
+
+    listeningSocket = socketDescriptor;
+    running = true;
+    ajustServers();
+    startMonitoring();
+    startScaling();
+    tSystemInfo("TreeFrog application servers start up.  socket:%d", socketDescriptor);
+    return true;
+}
+
 
 void ServerManager::stop()
 {
-    if (!isRunning())
+    if (!isRunning() && !draining)
         return;
     
+    if (!draining) {
+        // The status file of a draining generation is the one written
+        // by the next generation
+        QFile::remove(statusFilePath());
+    }
     running = false;
+    draining = false;
+    monitorTimer.stop();
+    scaleTimer.stop();
     
     if (listeningSocket > 0) {
         TF_CLOSE(listeningSocket);
@@ -125,11 +187,74 @@ void ServerManager::stop()
             delete tfserver;
         }
         serversStatus.clear();
+        serversUsage.clear();
         tSystemInfo("TreeFrog application servers shutdown completed");
     }
 }
 
 
+/*!
+  Reloads the settings and sends SIGHUP to the application servers,
+  which reload their settings and routes without stopping.
+*/
+void ServerManager::reload()
+{
+    if (!isRunning())
+        return;
+
+    tSystemInfo("Reloading TreeFrog application servers");
+    Tf::app()->reloadSettings();
+    startMonitoring();
+    startScaling();
+
+#ifdef Q_OS_UNIX
+    for (QMapIterator<QProcess *, int> i(serversStatus); i.hasNext(); ) {
+        Q_PID pid = i.next().key()->pid();
+        if (pid > 0) {
+            ::kill(pid, SIGHUP);
+        }
+    }
+#endif
+}
+
+
+/*!
+  Stops the servers gracefully, leaving the listening socket open for
+  the next generation. Each server stops accepting, finishes requests
+  in progress and then exits. This object is deleted when all the
+  servers have exited.
+*/
+void ServerManager::drain()
+{
+    if (!isRunning())
+        return;
+
+    running = false;
+    draining = true;
+    listeningSocket = 0;  // the next generation owns it
+    monitorTimer.stop();
+    scaleTimer.stop();
+
+    if (serverCount() == 0) {
+        deleteLater();
+        return;
+    }
+
+    tSystemInfo("TreeFrog application servers draining  count:%d", serverCount());
+    for (QMapIterator<QProcess *, int> i(serversStatus); i.hasNext(); ) {
+        QProcess *tfserver = i.next().key();
+#ifdef Q_OS_UNIX
+        Q_PID pid = tfserver->pid();
+        if (pid > 0) {
+            ::kill(pid, SIGQUIT);  // graceful shutdown
+        }
+#else
+        tfserver->terminate();
+#endif
+    }
+}
+
+
 bool ServerManager::isRunning() const
 {
     return running;
@@ -155,16 +280,62 @@ int ServerManager::spareServerCount() const
 }
 
 
+int ServerManager::serverCountOf(int state) const
+{
+    int count = 0;
+    for (QMapIterator<QProcess *, int> i(serversStatus); i.hasNext(); ) {
+        if (i.next().value() == state) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+/*
+  Starts servers if the spare servers are fewer than the target. While
+  they stay short, the number of servers started at once doubles up to
+  MAX_SPAWN_BATCH, so that a traffic spike is not served by servers
+  started one by one.
+*/
 void ServerManager::ajustServers() const
 {
     if (isRunning()) {
-        tSystemDebug("serverCount: %d  spare: %d", serverCount(), spareServerCount());
-        if (serverCount() < maxServers && (serverCount() < minServers || spareServerCount() < spareServers)) {
-            startServer();
+        // Servers being closed are replaced right away, and servers
+        // being started are counted as spare
+        int count = serverCount() - serverCountOf(Closing);
+        int spare = spareServerCount() + serverCountOf(NotRunning);
+        int need = qMin(qMax(minServers - count, spareTarget - spare), maxServers - count);
+        tSystemDebug("serverCount: %d  spare: %d  need: %d", count, spare, need);
+
+        if (need > 0) {
+            int num = qMin(need, spawnBatch);
+            for (int i = 0; i < num; ++i) {
+                startServer();
+            }
+            spawnBatch = qMin(spawnBatch * 2, MAX_SPAWN_BATCH);
+        } else {
+            spawnBatch = 1;
         }
     }
 }
 
+/*
+  Stops the server gracefully; it finishes the request in progress and
+  exits.
+*/
+void ServerManager::closeServer(QProcess *server) const
+{
+    serversStatus.insert(server, Closing);
+#ifdef Q_OS_UNIX
+    Q_PID pid = server->pid();
+    if (pid > 0) {
+        ::kill(pid, SIGQUIT);  // graceful shutdown
+    }
+#else
+    server->terminate();
+#endif
+}
+
 
 void ServerManager::startServer() const
 {
@@ -178,6 +349,10 @@ void ServerManager::startServer() const
 
     QProcess *tfserver = new QProcess;
     serversStatus.insert(tfserver, NotRunning);
+
+    ServerUsage usage;
+    usage.startTime = QDateTime::currentDateTime().toTime_t();
+    serversUsage.insert(tfserver, usage);
     
     connect(tfserver, SIGNAL(started()), this, SLOT(updateServerStatus()));
     connect(tfserver, SIGNAL(error(QProcess::ProcessError)), this, SLOT(errorDetect(QProcess::ProcessError)));
@@ -228,6 +403,12 @@ void ServerManager::errorDetect(QProcess::ProcessError error)
         //server->close();  // long blocking..
         server->deleteLater();
         serversStatus.remove(server);
+        serversUsage.remove(server);
+
+        if (draining && serversStatus.isEmpty()) {
+            deleteLater();
+            return;
+        }
 
         ajustServers();
     }
@@ -240,9 +421,18 @@ void ServerManager::serverFinish(int exitCode, QProcess::ExitStatus exitStatus)
     if (server) {
         //server->close();  // long blocking..
         server->deleteLater();
-        serversStatus.remove(server);
+        bool recycled = (serversStatus.take(server) == Closing);
+        serversUsage.remove(server);
+
+        if (draining) {
+            if (serversStatus.isEmpty()) {
+                tSystemInfo("TreeFrog application servers drained");
+                const_cast<ServerManager *>(this)->deleteLater();
+            }
+            return;
+        }
 
-        if (exitStatus == QProcess::CrashExit) {
+        if (exitStatus == QProcess::CrashExit || recycled) {
             ajustServers();
         } else {
             tSystemInfo("Detected normal exit of server. exitCode:%d", exitCode);
@@ -271,10 +461,34 @@ void ServerManager::readStandardError() const
     if (server) {
         QByteArray buf = server->readAllStandardError();
         if (buf == "_accepted") {
-            if (serversStatus.contains(server)) {
+            if (serversStatus.contains(server) && serversStatus.value(server) != Closing) {
                 serversStatus.insert(server, Running);
+                serversUsage[server].requests++;
+                ++acceptedCount;
                 ajustServers();
             }
+        } else if (buf == "_listening") {
+            // Server of thread MPM ready to accept
+            if (serversUsage.contains(server)) {
+                serversUsage[server].listening = true;
+            }
+
+            if (!serversReady && isRunning() && serverCount() >= minServers) {
+                bool all = true;
+                for (QMapIterator<QProcess *, ServerUsage> it(serversUsage); it.hasNext(); ) {
+                    all &= it.next().value().listening;
+                }
+                if (all) {
+                    tSystemInfo("TreeFrog application servers listening  count:%d", serverCount());
+                    serversReady = true;
+                    emit const_cast<ServerManager *>(this)->serversListening();
+                }
+            }
+        } else if (buf.startsWith("_requests:")) {
+            // Number of requests reported by the server of thread MPM
+            if (serversUsage.contains(server)) {
+                serversUsage[server].requests = buf.mid(10).trimmed().toLongLong();
+            }
         } else {
             tSystemWarn("treefrog stderr: %s", buf.constData());
             fprintf(stderr, "treefrog stderr: %s", buf.constData());
@@ -282,4 +496,200 @@ void ServerManager::readStandardError() const
     }
 }
 
+
+/*!
+  Returns the path of the file which the resource usage of the servers
+  is written to.
+*/
+QString ServerManager::statusFilePath()
+{
+    QString base = QFileInfo(QCoreApplication::applicationFilePath()).baseName();
+    return Tf::app()->tmpPath() + base + ".status";
+}
+
+/*
+  (Re)starts the timer to sample the resource usage of the servers
+  with the current settings.
+*/
+void ServerManager::startMonitoring()
+{
+    int interval = Tf::app()->appSettings().value(MONITOR_INTERVAL, 60).toInt();
+    maxServerMemory = Tf::app()->appSettings().value(MONITOR_MAX_SERVER_MEMORY, 0).toLongLong() * 1024 * 1024;
+
+    monitorTimer.stop();
+    if (interval > 0) {
+        monitorTimer.start(interval * 1000, this);
+    } else {
+        QFile::remove(statusFilePath());
+    }
+}
+
+/*
+  Samples the resident memory size, CPU time, numbers of threads and
+  file descriptors of each server, logs them and recycles the servers
+  exceeding the memory threshold.
+*/
+void ServerManager::monitorServers()
+{
+    qint64 now = tMicroseconds();
+    QList<QProcess *> exceeded;
+
+    for (QMutableMapIterator<QProcess *, ServerUsage> it(serversUsage); it.hasNext(); ) {
+        it.next();
+        QProcess *server = it.key();
+        ServerUsage &usage = it.value();
+        qint64 pid = processIdOf(server);
+        if (pid <= 0)
+            continue;
+
+        ProcessInfo pi(pid);
+        qint64 cpu = pi.cpuTime();
+        if (cpu >= 0 && usage.cpuTime >= 0 && now > usage.sampledAt) {
+            usage.cpuUsage = (cpu - usage.cpuTime) * 100000.0 / (now - usage.sampledAt);
+        }
+        usage.cpuTime = cpu;
+        usage.sampledAt = now;
+        usage.residentMemory = pi.residentMemorySize();
+        usage.threads = pi.threadCount();
+        usage.fileDescriptors = pi.fileDescriptorCount();
+
+        tSystemInfo("Server usage  pid:%ld  rss:%ldKB  cpu:%.1fsec(%.1f%%)  threads:%d  fds:%d  requests:%ld",
+                    (long)pid, (long)(usage.residentMemory / 1024), usage.cpuTime / 1000.0, usage.cpuUsage,
+                    usage.threads, usage.fileDescriptors, (long)usage.requests);
+
+        if (maxServerMemory > 0 && usage.residentMemory > maxServerMemory
+            && serversStatus.value(server) != Closing) {
+            exceeded << server;
+        }
+    }
+
+    for (QListIterator<QProcess *> it(exceeded); it.hasNext(); ) {
+        recycleServer(it.next());
+    }
+    writeStatus();
+}
+
+/*
+  Stops the server gracefully and starts another one in its place.
+*/
+void ServerManager::recycleServer(QProcess *server)
+{
+    if (!isRunning() || !serversStatus.contains(server))
+        return;
+
+    const ServerUsage &usage = serversUsage[server];
+    tSystemWarn("Recycling the server exceeding the memory threshold  pid:%ld  rss:%ldKB  limit:%ldKB",
+                (long)processIdOf(server), (long)(usage.residentMemory / 1024), (long)(maxServerMemory / 1024));
+
+    closeServer(server);
+    ajustServers();
+}
+
+/*
+  Starts the timer to scale the number of servers with the load, which
+  is used only if the number can vary, i.e. prefork MPM.
+*/
+void ServerManager::startScaling()
+{
+    scaleDownDelay = qMax(Tf::app()->appSettings().value(SCALE_DOWN_DELAY, 30).toInt(), 0);
+    lastBusyTime = tMicroseconds();
+
+    if (maxServers > minServers && !scaleTimer.isActive()) {
+        scaleTimer.start(SCALE_INTERVAL, this);
+    }
+}
+
+/*
+  Sets the target number of spare servers from the request rate and
+  the number of connections waiting to be accepted, and starts servers
+  to meet it. When the load has stayed below the target for the
+  scale-down delay, retires an idle server per interval down to the
+  minimum number.
+*/
+void ServerManager::scaleServers()
+{
+    if (!isRunning())
+        return;
+
+    // Requests per second, smoothed
+    double count = acceptedCount * 1000.0 / SCALE_INTERVAL;
+    requestRate = requestRate * 0.7 + count * 0.3;
+    acceptedCount = 0;
+    queueDepth = acceptQueueDepth();
+
+    // Keeps the servers for the requests of a second at least
+    spareTarget = qBound(spareServers, queueDepth + qCeil(requestRate), maxServers);
+    qint64 now = tMicroseconds();
+
+    if (queueDepth > 0 || spareServerCount() < spareTarget) {
+        lastBusyTime = now;
+        ajustServers();
+        return;
+    }
+
+    if (spareServerCount() > spareTarget && serverCount() - serverCountOf(Closing) > minServers
+        && now - lastBusyTime >= scaleDownDelay * Q_INT64_C(1000000)) {
+        for (QMapIterator<QProcess *, int> i(serversStatus); i.hasNext(); ) {
+            i.next();
+            if (i.value() == Listening) {
+                tSystemDebug("Retiring an idle server  pid:%ld  rate:%.1f/s", (long)processIdOf(i.key()), requestRate);
+                closeServer(i.key());
+                break;
+            }
+        }
+    }
+}
+
+/*
+  Writes the last sampled usage of the servers to the status file,
+  which is shown by the 'status' command.
+*/
+void ServerManager::writeStatus() const
+{
+    static const char *const stateNames[] = { "starting", "listening", "running", "closing" };
+
+    QFile file(statusFilePath());
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        tSystemError("File open failed: %s", qPrintable(file.fileName()));
+        return;
+    }
+
+    QTextStream ts(&file);
+    QDateTime now = QDateTime::currentDateTime();
+    ts << "Sampled at " << now.toString("yyyy-MM-dd hh:mm:ss") << "  servers:" << serverCount();
+    if (maxServerMemory > 0) {
+        ts << "  memory limit:" << maxServerMemory / 1024 << "KB";
+    }
+    if (scaleTimer.isActive()) {
+        ts << "  spare target:" << spareTarget << "  request rate:" << QString::number(requestRate, 'f', 1)
+           << "/s  accept queue:" << queueDepth;
+    }
+    ts << "\n\n";
+    ts << QString("%1 %2 %3 %4 %5 %6 %7 %8 %9\n").arg("PID", 8).arg("STATE", -10).arg("UPTIME", 9)
+        .arg("RSS(KB)", 10).arg("CPU(s)", 9).arg("CPU%", 6).arg("THREADS", 7).arg("FDS", 6).arg("REQUESTS", 9);
+
+    uint current = now.toTime_t();
+    for (QMapIterator<QProcess *, ServerUsage> it(serversUsage); it.hasNext(); ) {
+        it.next();
+        const ServerUsage &usage = it.value();
+        int state = qBound(0, serversStatus.value(it.key()), (int)Closing);
+        ts << QString("%1 %2 %3 %4 %5 %6 %7 %8 %9\n").arg(processIdOf(it.key()), 8).arg(stateNames[state], -10)
+            .arg(current - usage.startTime, 9).arg(usage.residentMemory / 1024, 10)
+            .arg(usage.cpuTime / 1000.0, 9, 'f', 1).arg(usage.cpuUsage, 6, 'f', 1)
+            .arg(usage.threads, 7).arg(usage.fileDescriptors, 6).arg(usage.requests, 9);
+    }
+}
+
+
+void ServerManager::timerEvent(QTimerEvent *event)
+{
+    if (event->timerId() == monitorTimer.timerId()) {
+        monitorServers();
+    } else if (event->timerId() == scaleTimer.timerId()) {
+        scaleServers();
+    } else {
+        QObject::timerEvent(event);
+    }
+}
+
 } // namespace TreeFrog
@@ -4,6 +4,8 @@
 #include <QObject>
 #include <QHostAddress>
 #include <QProcess>
+#include <QMap>
+#include <QBasicTimer>
 
 namespace TreeFrog {
 
@@ -17,10 +19,14 @@ public:
 
     bool start(const QHostAddress &address = QHostAddress::Any, quint16 port = 0);
     bool start(const QString &fileDomain);  // For UNIX domain
+    bool startWithSocket(int socketDescriptor);
     void stop();
     bool isRunning() const;
+    bool isDraining() const { return draining; }
+    int listeningSocketDescriptor() const { return listeningSocket; }
     int serverCount() const;
     int spareServerCount() const;
+    static QString statusFilePath();
 
 protected:
     enum ServerProcessState {
@@ -30,9 +36,41 @@ protected:
         Closing,
     };
 
+    struct ServerUsage
+    {
+        qint64 startTime;      // in secs since the epoch
+        qint64 residentMemory; // in bytes
+        qint64 cpuTime;        // in msecs
+        double cpuUsage;       // in percent
+        int threads;
+        int fileDescriptors;
+        qint64 requests;
+        qint64 sampledAt;      // in microsecs, monotonic
+        bool listening;        // reported '_listening'
+
+        ServerUsage() : startTime(0), residentMemory(-1), cpuTime(-1), cpuUsage(0), threads(-1), fileDescriptors(-1), requests(0), sampledAt(0), listening(false) { }
+    };
+
     void ajustServers() const;
     void startServer() const;
+    int serverCountOf(int state) const;
+    void closeServer(QProcess *server) const;
+    void startMonitoring();
+    void monitorServers();
+    void recycleServer(QProcess *server);
+    void startScaling();
+    void scaleServers();
+    int acceptQueueDepth() const;
+    void writeStatus() const;
+    void timerEvent(QTimerEvent *event);
     
+public slots:
+    void reload();
+    void drain();
+
+signals:
+    void serversListening();
+
 protected slots:
     void updateServerStatus();
     void errorDetect(QProcess::ProcessError error);
@@ -41,11 +79,25 @@ protected slots:
     void readStandardError() const;
 
 private:
+    mutable QMap<QProcess *, int> serversStatus;
+    mutable QMap<QProcess *, ServerUsage> serversUsage;
     int listeningSocket;
     int maxServers;
     int minServers;
     int spareServers;
     volatile bool running;
+    bool draining;
+    mutable bool serversReady;
+    QBasicTimer monitorTimer;
+    qint64 maxServerMemory;
+    QBasicTimer scaleTimer;
+    int scaleDownDelay;
+    int spareTarget;
+    mutable int spawnBatch;
+    mutable int acceptedCount;
+    double requestRate;
+    int queueDepth;
+    qint64 lastBusyTime;
     
     Q_DISABLE_COPY(ServerManager)
 };
@@ -6,3 +6,30 @@
  */
 
 #include "servermanager.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+namespace TreeFrog {
+
+/*!
+  Returns the number of connections waiting to be accepted on the
+  listening socket. It's available only for TCP on Linux; otherwise
+  returns 0.
+*/
+int ServerManager::acceptQueueDepth() const
+{
+#if defined(Q_OS_LINUX) && defined(TCP_INFO)
+    if (listeningSocket > 0) {
+        struct tcp_info info;
+        socklen_t len = sizeof(info);
+        if (getsockopt(listeningSocket, IPPROTO_TCP, TCP_INFO, &info, &len) == 0) {
+            return info.tcpi_unacked;  // current backlog of a listening socket
+        }
+    }
+#endif
+    return 0;
+}
+
+} // namespace TreeFrog
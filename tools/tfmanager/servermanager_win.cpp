@@ -6,3 +6,14 @@
  */
 
 #include "servermanager.h"
+
+namespace TreeFrog {
+
+
+int ServerManager::acceptQueueDepth() const
+{
+    // Not supported
+    return 0;
+}
+
+} // namespace TreeFrog
@@ -52,6 +52,10 @@ win32 {
   LIBS += -lws2_32
   SOURCES += processinfo_win.cpp
   SOURCES += windowsservice_win.cpp
+  SOURCES += servermanager_win.cpp
+}
+unix {
+  SOURCES += servermanager_unix.cpp
 }
 linux-* {
   SOURCES += processinfo_linux.cpp
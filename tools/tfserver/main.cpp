@@ -77,6 +77,9 @@ int main(int argc, char *argv[])
 
 #if defined(Q_OS_UNIX)
     webapp.watchUnixSignal(SIGTERM);
+    webapp.watchUnixSignal(SIGHUP);  // reloads settings and routes
+    webapp.watchUnixSignal(SIGQUIT); // graceful shutdown
+    webapp.watchUnixSignal(SIGUSR2); // dumps the function trace
     if (!args.contains(CTRL_C_OPTION)) {
         webapp.ignoreUnixSignal(SIGINT);
     }